@@ -0,0 +1,69 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "Collision.hpp"
+
+// Moves a player-sized box through random blocks at walking, falling and
+// ghost-mode speeds, and checks it never ends inside a block
+
+static const int MOVES = 200000;
+
+static void bench_speed(std::vector<Chunk>& world, const char* name, float speed)
+{
+    VoxelCollider collider(world);
+    VoxelCollider checker(world);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+    Aabb box = {glm::vec3(0.2f, 10.2f, 0.2f), glm::vec3(0.8f, 12.0f, 0.8f)};
+    size_t tunnelled = 0;
+    size_t blocked_moves = 0;
+    double seconds = 0;
+
+    for (int i = 0; i < MOVES; i++) {
+        glm::vec3 delta = glm::vec3(direction(rng), direction(rng), direction(rng)) * speed;
+        glm::bvec3 blocked;
+        auto start = std::chrono::high_resolution_clock::now();
+        collider.move(box, delta, blocked);
+        seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        blocked_moves += blocked.x || blocked.y || blocked.z;
+        tunnelled += checker.overlaps_block(box);
+        // Stay over the loaded chunks
+        glm::vec3 center = (box.min + box.max) * 0.5f;
+        if (center.x < -20 || center.x > 20 || center.z < -20 || center.z > 20 || center.y < 2 || center.y > 90) {
+            box = {glm::vec3(0.2f, 10.2f, 0.2f), glm::vec3(0.8f, 12.0f, 0.8f)};
+        }
+    }
+
+    std::cout << name << " (" << speed << " blocks/move): " << seconds / MOVES * 1e9 << " ns/move, "
+        << collider.chunk_lookups / (float)MOVES << " chunk lookups/move, " << blocked_moves << " blocked, "
+        << tunnelled << " inside a block" << std::endl;
+}
+
+int main()
+{
+    std::vector<Chunk> world;
+    std::mt19937 rng(1);
+    for (int x = -2; x < 2; x++) {
+        for (int z = -2; z < 2; z++) {
+            Chunk& chunk = world.emplace_back(glm::vec2(x, z));
+            for (int bx = 0; bx < 16; bx++) {
+                for (int y = 0; y < 100; y++) {
+                    for (int bz = 0; bz < 16; bz++) {
+                        chunk.blocks[bx][y][bz] = {glm::ivec3(bx, y, bz), (uint16_t)(rng() % 12 == 0 ? 1 : 0)};
+                    }
+                }
+            }
+        }
+    }
+    // The start position is always free
+    for (int y = 10; y < 12; y++) {
+        world[10].blocks[0][y][0].type = 0;
+    }
+
+    bench_speed(world, "walking", 0.1f);
+    bench_speed(world, "falling", 1.0f);
+    bench_speed(world, "ghost", 8.0f);
+    return 0;
+}
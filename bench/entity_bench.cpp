@@ -0,0 +1,88 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "EntityStore.hpp"
+
+// Drops 10k items and mobs on uneven ground and runs 10 s of 60 Hz ticks,
+// on the calling thread alone and on a thread pool, and checks none of them
+// ends inside a block
+
+static const size_t ENTITIES = 10000;
+static const int TICKS = 600;
+static const double TICK_MS = 1000.0 / 60.0;
+
+static void spawn_entities(EntityStore& entities)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> horizontal(-56.0f, 56.0f);
+    std::uniform_real_distribution<float> height(5.0f, 50.0f);
+    std::uniform_real_distribution<float> speed(-0.2f, 0.2f);
+    for (size_t i = 0; i < ENTITIES; i++) {
+        glm::vec3 pos(horizontal(rng), height(rng), horizontal(rng));
+        glm::vec3 velocity(speed(rng), 0.0f, speed(rng));
+        if (i % 2 == 0) {
+            entities.spawn(ENTITY_ITEM, pos, glm::vec3(0.125f), velocity);
+        } else {
+            entities.spawn(ENTITY_MOB, pos, glm::vec3(0.3f, 0.9f, 0.3f), velocity);
+        }
+    }
+}
+
+static void bench_ticks(std::vector<Chunk>& world, const char* name, ThreadPool* pool)
+{
+    EntityStore entities(ENTITIES);
+    spawn_entities(entities);
+    double total_ms = 0;
+    double worst_ms = 0;
+    double hash_ms = 0;
+    size_t pair_tests = 0;
+
+    for (int tick = 0; tick < TICKS; tick++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        entities.update(world, pool);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        total_ms += ms;
+        worst_ms = std::max(worst_ms, ms);
+        hash_ms += entities.hash_ms;
+        pair_tests += entities.pair_tests;
+    }
+
+    VoxelCollider checker(world);
+    size_t inside = 0;
+    size_t grounded = 0;
+    for (size_t i = 0; i < entities.count; i++) {
+        inside += checker.overlaps_block(entities.get_box(i));
+        grounded += entities.on_ground[i];
+    }
+    std::cout << name << ": " << total_ms / TICKS << " ms/tick (" << total_ms / TICKS / TICK_MS * 100 << "% of a 60 Hz tick), worst "
+        << worst_ms << " ms, hash " << hash_ms / TICKS << " ms, " << pair_tests / TICKS << " mob pair tests/tick, "
+        << grounded << " on the ground, " << inside << " inside a block" << std::endl;
+}
+
+int main()
+{
+    std::vector<Chunk> world;
+    std::mt19937 rng(1);
+    for (int x = -4; x < 4; x++) {
+        for (int z = -4; z < 4; z++) {
+            Chunk& chunk = world.emplace_back(glm::vec2(x, z));
+            for (int bx = 0; bx < 16; bx++) {
+                for (int bz = 0; bz < 16; bz++) {
+                    // y points down, the ground starts between 55 and 60
+                    int ground = 55 + rng() % 6;
+                    for (int y = 0; y < 100; y++) {
+                        chunk.blocks[bx][y][bz] = {glm::ivec3(bx, y, bz), (uint16_t)(y >= ground ? 1 : 0)};
+                    }
+                }
+            }
+        }
+    }
+
+    bench_ticks(world, "1 thread", nullptr);
+    ThreadPool pool;
+    std::string name = std::to_string(pool.workers.size() + 1) + " threads";
+    bench_ticks(world, name.c_str(), &pool);
+    return 0;
+}
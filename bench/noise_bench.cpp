@@ -0,0 +1,54 @@
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+
+#include "FastNoiseLite.hpp"
+#include "NoiseBatch.hpp"
+
+// Compares NoiseBatch::get_noise_grid with per-column GetNoise on the
+// terrain settings of the Bassicraft constructor
+
+static const int CHUNKS = 20000;
+
+static double bench_level(const FastNoiseLite& noise, NoiseBatch::SimdLevel level, std::vector<float>& out)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < CHUNKS; i++) {
+        NoiseBatch::get_noise_grid(noise, (i % 200 - 100) * 16.0f, (i / 200 - 50) * 16.0f, out.data() + i * 256, level);
+    }
+    float seconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+    return CHUNKS * 256 / seconds;
+}
+
+int main()
+{
+    FastNoiseLite noise;
+    noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+    noise.SetSeed(rand());
+    noise.SetFrequency(0.01f);
+    noise.SetFractalType(FastNoiseLite::FractalType_FBm);
+    noise.SetFractalOctaves(3);
+    noise.SetFractalLacunarity(2.0f);
+    noise.SetFractalGain(0.5f);
+
+    std::vector<float> reference(CHUNKS * 256);
+    std::vector<float> out(CHUNKS * 256);
+
+    double scalar = bench_level(noise, NoiseBatch::SimdLevel_Scalar, reference);
+    std::cout << "scalar: " << scalar / 1e6 << " M columns/s" << std::endl;
+
+    const char* names[] = {"scalar", "sse4.1", "avx2"};
+    for (int level = NoiseBatch::SimdLevel_SSE41; level <= NoiseBatch::get_simd_level(); level++) {
+        double rate = bench_level(noise, (NoiseBatch::SimdLevel)level, out);
+        size_t mismatches = 0;
+        for (size_t i = 0; i < out.size(); i++) {
+            if (memcmp(&out[i], &reference[i], sizeof(float)) != 0) {
+                mismatches++;
+            }
+        }
+        std::cout << names[level] << ": " << rate / 1e6 << " M columns/s (x" << rate / scalar << "), " << mismatches << " mismatches" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <array>
+
+#include "RegionEditor.hpp"
+#include "LightEngine.hpp"
+#include "WorldGenerator.hpp"
+#include "ThreadPool.hpp"
+
+// Edits a 100x100x100 box of generated terrain with each RegionEditor
+// operation, relights the edited chunks and the ring around them with
+// LightEngine::relight_chunks like Bassicraft::finish_region_edit, and checks the light against lighting the
+// whole world again. Meshing and uploads need the GPU and are left out.
+
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static void relight_world(std::vector<Chunk>& world, LightEngine& lighting)
+{
+    for (auto& chunk : world) {
+        lighting.light_chunk(chunk);
+    }
+    lighting.set_world(world);
+    for (auto& chunk : world) {
+        lighting.stitch_chunk(chunk);
+    }
+}
+
+static void bench_edit(std::vector<Chunk>& world, LightEngine& lighting, ThreadPool& pool, RegionEditor& editor, const char* name, size_t blocks, double edit_ms)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    lighting.set_world(world);
+    std::vector<Chunk*> relit = lighting.relight_chunks(editor.touched, pool);
+    double light_ms = elapsed_ms(start);
+
+    std::vector<std::array<uint8_t, 16 * 100 * 16>> edited;
+    for (auto& chunk : world) {
+        edited.push_back(chunk.light);
+    }
+    relight_world(world, lighting);
+    size_t wrong = 0;
+    for (size_t c = 0; c < world.size(); c++) {
+        for (size_t i = 0; i < edited[c].size(); i++) {
+            wrong += edited[c][i] != world[c].light[i];
+        }
+    }
+    std::cout << name << ": " << blocks << " blocks in " << editor.touched.size() << " chunks, edit " << edit_ms << " ms, light "
+        << light_ms << " ms over " << relit.size() << " chunks, total " << edit_ms + light_ms << " ms, "
+        << wrong << " blocks lit differently from a full relight" << std::endl;
+    editor.touched.clear();
+}
+
+int main()
+{
+    for (int type = 0; type < 257; type++) {
+        Chunk::see_through[type] = type == 0 || type == 206 || type == 68;
+    }
+    WorldGenerator generator;
+    generator.set_seed(1);
+    std::vector<Chunk> world;
+    world.reserve(12 * 12);
+    for (int x = -6; x < 6; x++) {
+        for (int z = -6; z < 6; z++) {
+            world.emplace_back(glm::vec2(x, z), generator).compute_heightmap();
+        }
+    }
+    LightEngine lighting;
+    relight_world(world, lighting);
+    ThreadPool pool;
+    RegionEditor editor;
+    editor.chunks.set_world(world);
+
+    glm::ivec3 min(-50, 0, -50);
+    glm::ivec3 max(49, 99, 49);
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t blocks = editor.fill(min, max, 1);
+    bench_edit(world, lighting, pool, editor, "fill", blocks, elapsed_ms(start));
+
+    start = std::chrono::high_resolution_clock::now();
+    blocks = editor.sphere(min, max, 0);
+    bench_edit(world, lighting, pool, editor, "sphere", blocks, elapsed_ms(start));
+
+    start = std::chrono::high_resolution_clock::now();
+    blocks = editor.replace(min, max, 1, 206);
+    bench_edit(world, lighting, pool, editor, "replace", blocks, elapsed_ms(start));
+
+    start = std::chrono::high_resolution_clock::now();
+    BlockRegion region = editor.copy(min, glm::ivec3(-1, 99, -1));
+    blocks = editor.paste(region, glm::ivec3(0, 0, 0), true);
+    bench_edit(world, lighting, pool, editor, "copy and paste", blocks, elapsed_ms(start));
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+
+#include "FastNoiseLite.hpp"
+#include "StaticNoise.hpp"
+
+// Compares StaticNoise::get_noise with the runtime-dispatched
+// FastNoiseLite::GetNoise for the terrain and biome settings
+
+static const int SAMPLES = 4000000;
+
+template <typename Config>
+static void bench_config(const char* name)
+{
+    FastNoiseLite noise;
+    StaticNoise<Config>::configure(noise);
+    noise.SetSeed(rand());
+    StaticNoise<Config> static_noise(noise);
+
+    std::vector<float> reference(SAMPLES);
+    std::vector<float> out(SAMPLES);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < SAMPLES; i++) {
+        reference[i] = noise.GetNoise((float)(i % 2000 - 1000), (float)(i / 2000 - 1000));
+    }
+    float runtime_seconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < SAMPLES; i++) {
+        out[i] = static_noise.get_noise((float)(i % 2000 - 1000), (float)(i / 2000 - 1000));
+    }
+    float static_seconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+
+    size_t mismatches = 0;
+    for (int i = 0; i < SAMPLES; i++) {
+        if (memcmp(&out[i], &reference[i], sizeof(float)) != 0) {
+            mismatches++;
+        }
+    }
+
+    std::cout << name << ": GetNoise " << SAMPLES / runtime_seconds / 1e6 << " M samples/s, StaticNoise "
+        << SAMPLES / static_seconds / 1e6 << " M samples/s (x" << runtime_seconds / static_seconds << "), "
+        << mismatches << " mismatches" << std::endl;
+}
+
+int main()
+{
+    bench_config<TerrainNoiseConfig>("terrain");
+    bench_config<BiomeNoiseConfig>("biome");
+    return 0;
+}
@@ -9,7 +9,13 @@
 #include "Cube.hpp"
 #include "Player.hpp"
 #include "Chunk.hpp"
-#include "FastNoiseLite.hpp"
+#include "WorldGenerator.hpp"
+#include "ChunkPipeline.hpp"
+#include "LightEngine.hpp"
+#include "Raycast.hpp"
+#include "EntityStore.hpp"
+#include "BlockUpdater.hpp"
+#include "RegionEditor.hpp"
 #include "TextureDataStruct.hpp"
 #include "Inventory.hpp"
 
@@ -19,13 +25,62 @@ private:
     VkEngine engine;
     Player player;
     
-    FastNoiseLite noise;
-    FastNoiseLite biome_noise;
+    WorldGenerator generator;
+    ChunkStorage storage;
+    ChunkPipeline pipeline{generator, storage};
+    LightEngine lighting;
+    BlockUpdater block_updates;
+    RegionEditor region_editor;
 
     int render_distance = 8;
+    // Chunk distances at which meshes switch to 2x, 4x and 8x cells
+    std::array<int, 3> lod_distances = {3, 5, 7};
+    int max_lod_rebuilds_per_frame = 4;
+    // Chunks relit by an edit or a neighbour loading, besides the edited
+    // one, or changed by block updates
+    int max_remeshes_per_frame = 2;
+    // Index in world the next frame starts looking for dirty chunks at, so
+    // chunks late in the world are not starved by the first ones
+    size_t remesh_start = 0;
+    // Chunks are also loaded around where the player will be in this many
+    // ticks at the current velocity
+    int prefetch_ticks = 30;
+    // Movement, gravity and particles advance in steps of TICK_SECONDS
+    // whatever the frame rate, frames are drawn between the last two ticks
+    static constexpr double TICK_SECONDS = 1.0 / 60.0;
+    // Slower frames drop the time past this many ticks instead of catching up
+    int max_ticks_per_frame = 5;
+    float time_scale = 1.0f;
+    double tick_accumulator = 0.0;
+    size_t ticks = 0;
+    glm::vec3 previous_camera_pos{0.0f};
+    // Chunks in the view cone that are not loaded yet, in the last frame and
+    // how many frames had some
+    int visible_unloaded_chunks = 0;
+    size_t frames_with_unloaded_chunks = 0;
+    size_t counted_frames = 0;
+
+    // Box edited from the debug window, corners included
+    glm::ivec3 region_min{0, 0, 0};
+    glm::ivec3 region_max{0, 0, 0};
+    int region_type = 1;
+    int region_replaced_type = 0;
+    bool paste_air = true;
+    BlockRegion clipboard;
+    // Cost of the last region edit
+    size_t region_blocks = 0;
+    size_t region_chunks = 0;
+    float region_ms = 0.0f;
+
+    glm::ivec3 last_sort_block{0, 0, 0};
+    bool translucent_sort_dirty = true;
     bool is_cursor_locked = true;
 
     std::vector<Chunk> world;
+    Raycaster raycaster{world};
+    VoxelCollider collider{world};
+    // Not drawn yet, only simulated
+    EntityStore entities{10000};
 
     MyTextureData crosshair;
 
@@ -38,7 +93,7 @@ private:
     int width;
     int height;
 public:
-    Bassicraft(/* args */);
+    Bassicraft(uint32_t seed);
     ~Bassicraft();
 
     void init_engine();
@@ -46,7 +101,25 @@ public:
     void add_cube(Chunk& chunk, Cube& cube);
     void remove_cube(Chunk& chunk, glm::ivec3 pos, Cube& cube);
     void set_blocks_in_vertex_buffer(Chunk& chunk);
+    void set_blocks_in_vertex_buffer_lod(Chunk& chunk);
+    void rebuild_mesh(Chunk& chunk);
+    void remesh_chunk(Chunk& chunk);
+    // Meshes every chunk on the pool and uploads them after a single wait
+    // for the GPU
+    void remesh_chunks(const std::vector<Chunk*>& chunks);
+    void mark_border_light_changes(Chunk& chunk);
+    int get_chunk_lod(int current_lod, int distance);
+    glm::ivec2 get_player_chunk();
+    void update_chunks_lod();
+    void update_light(Chunk& chunk, glm::ivec3 pos, uint16_t old_type);
+    void schedule_block_updates(Chunk& chunk, glm::ivec3 pos);
+    void finish_region_edit(glm::ivec3 min, glm::ivec3 max);
+    int get_surface_y(int x, int z);
+    void remesh_dirty_chunks();
+    void run_block_updates();
+    void sort_translucent_chunks();
     void unload_load_new_chunks();
+    int count_visible_unloaded_chunks();
     void mouse_buttons(GLFWwindow* window, int button, int action, int mods);
     void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
     glm::vec4 get_cube_pointed_at(bool for_placing);
@@ -54,5 +127,7 @@ public:
     void display_crosshair();
     void display_inventory();
     void move_player();
-    bool chunk_collision(glm::vec3 pos);
+    void tick();
+    void simulate(int count);
+    void draw_interpolated();
 };
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "Chunk.hpp"
+#include "ChunkMap.hpp"
+#include "ThreadPool.hpp"
+
+// Block to look at again once the tick reaches due, in world coordinates
+struct BlockUpdate
+{
+    glm::ivec3 pos;
+    uint64_t due;
+};
+
+// Result of an update, only applied if the block is still expected. With
+// needs_previous it is dropped when the change before it was, so a falling
+// block never vanishes or doubles.
+struct BlockChange
+{
+    glm::ivec3 pos;
+    uint16_t expected;
+    uint16_t type;
+    uint8_t level;
+    bool needs_previous;
+};
+
+// Scheduled block updates for fluids and falling blocks. Updates wait in a
+// queue per 16x16x16 section, the sections with updates are visited in
+// turn until max_updates_per_tick have run. Each section computes its
+// changes on a worker from the blocks as they were at the start of the
+// tick, then the main thread applies them in section order and schedules
+// the neighbours of every changed block.
+//
+// Fluids flow down as level 7 and sideways one level lower per block down
+// to 1, sources are level 8 and are not stored. Flowing fluid fed by
+// nothing higher drains back one level per update.
+class BlockUpdater
+{
+private:
+public:
+    enum Behaviour : uint8_t
+    {
+        BEHAVIOUR_STATIC,
+        BEHAVIOUR_FLUID,
+        BEHAVIOUR_FALLING
+    };
+
+    static const uint8_t SOURCE_LEVEL = 8;
+    static const uint8_t FALLING_LEVEL = 7;
+    // Type returned for blocks in chunks that are not loaded, nothing flows
+    // or falls into them
+    static const uint16_t UNLOADED = 256;
+
+    // Read-only once set, like LightEngine::emission
+    std::array<Behaviour, 257> behaviour{};
+    // Ticks between an update being scheduled and running, by behaviour
+    std::array<int, 3> delays = {0, 15, 2};
+    size_t max_updates_per_tick = 2048;
+
+    ChunkMap chunks;
+    // Pending updates by section, a section is in active once while it
+    // has any
+    std::unordered_map<uint64_t, std::vector<BlockUpdate>> sections;
+    std::deque<uint64_t> active;
+    uint64_t tick = 0;
+
+    // Cost of the last tick
+    size_t last_updates = 0;
+    size_t last_changes = 0;
+    float last_ms = 0.0f;
+
+    static uint64_t get_section_key(glm::ivec3 section);
+    Chunk* resolve(glm::ivec3 pos, glm::ivec3& local) const;
+    uint16_t get_type(glm::ivec3 pos) const;
+    uint8_t get_level(glm::ivec3 pos) const;
+    size_t get_pending() const;
+    void schedule(glm::ivec3 pos, int delay);
+    // Schedules pos and its six neighbours, the static ones are skipped
+    void schedule_around(glm::ivec3 pos);
+    void run_update(glm::ivec3 pos, std::vector<BlockChange>& changes) const;
+    // Runs the due updates and applies their changes, applied gets each
+    // block whose type changed with its old type as expected
+    void update(ThreadPool* pool, std::vector<BlockChange>& applied);
+};
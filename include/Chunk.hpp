@@ -2,33 +2,83 @@
 
 #include <vector>
 #include <array>
+#include <unordered_map>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "Cube.hpp"
 #include "Vertex.hpp"
-#include "FastNoiseLite.hpp"
+#include "ChunkMesh.hpp"
+#include "WorldGenerator.hpp"
+
+// Block placed by a decoration, in world coordinates so it can land in a
+// neighbouring chunk
+struct DecorationBlock
+{
+    glm::ivec3 pos;
+    uint16_t type;
+};
 
 class Chunk
 {
 private:
 public:
-    VkBuffer vk_vertex_buffer;
-    VkDeviceMemory vk_vertex_buffer_memory;
-    VkBuffer vk_index_buffer;
-    VkDeviceMemory vk_index_buffer_memory;
-
     glm::vec2 pos;
     std::array<std::array<std::array<Cube, 16>, 100>, 16> blocks{{glm::ivec3(0, 0, 0), 0}};
 
-    std::vector<Vertex> vertices{};
-    std::vector<uint32_t> indices{};
+    std::array<ChunkMesh, BUCKET_COUNT> meshes{};
 
     bool should_be_deleted = false;
+    // Edited by the player since it was generated or loaded, saved on unload
+    bool modified = false;
+    // Every block the player changed, by (x * 100 + y) * 16 + z, replayed
+    // over the generated blocks
+    std::unordered_map<uint16_t, uint16_t> edits;
+    // Size in blocks of one meshed cell (1, 2, 4 or 8)
+    int lod = 1;
+    // Sky light in the high nibble and block light in the low one, by
+    // (x * 100 + y) * 16 + z, see LightEngine
+    std::array<uint8_t, 16 * 100 * 16> light{};
+    // Light of the blocks just past each side, -x, +x, -z then +z, by
+    // y * 16 + position along the side. Copied from the neighbours before
+    // meshing, full sky light until a neighbour is there.
+    std::array<std::array<uint8_t, 100 * 16>, 4> border_light;
+    // The light changed since the chunk was meshed
+    bool light_dirty = false;
+    // The blocks changed since the chunk was meshed, remeshed within the
+    // same per-frame budget as light_dirty
+    bool mesh_dirty = false;
+    // Level of each flowing fluid block by (x * 100 + y) * 16 + z, sources
+    // are not stored, see BlockUpdater
+    std::unordered_map<uint16_t, uint8_t> fluid_levels;
+    // First block from the top that is not see-through in each column, by
+    // x * 16 + z, 100 when the sky reaches the bottom. Kept with
+    // opaque_counts by compute_heightmap and update_heightmap.
+    std::array<uint8_t, 256> heightmap{};
+    // Blocks that are not see-through in each layer
+    std::array<uint16_t, 100> opaque_counts{};
+
+    // Blocks light and sky go through, set once the textures are loaded
+    static std::array<bool, 257> see_through;
+
+    // ChunkRandom stream of the tree placement
+    static const uint32_t TREE_STREAM = 1;
 
-    void put_tree(glm::ivec3 pos);
+    static void put_tree(glm::ivec3 pos, std::vector<DecorationBlock>& decoration);
+    void decorate(WorldGenerator& generator, std::vector<DecorationBlock>& decoration);
+    void apply_decoration(const std::vector<DecorationBlock>& decoration);
+    void fill_density(WorldGenerator& generator, const std::array<int, 256>& heights, uint16_t block_surface, uint16_t block_under_surface, uint16_t water_type);
+    void record_edit(glm::ivec3 pos, uint16_t type);
+    void apply_edits();
+    void set_types(const std::vector<uint16_t>& types);
+    uint16_t get_lod_block(int x, int y, int z, int scale);
+    uint8_t get_face_light(int x, int y, int z) const;
+    void compute_heightmap();
+    void update_heightmap(glm::ivec3 pos, uint16_t old_type);
+    int get_surface(int x, int z) const;
+    bool is_layer_buried(int y) const;
 
-    Chunk(glm::vec2 pos, FastNoiseLite& noise, FastNoiseLite& biome_noise);
-    ~Chunk();
+    Chunk(glm::vec2 pos);
+    Chunk(glm::vec2 pos, WorldGenerator& generator);
 };
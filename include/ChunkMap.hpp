@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+class Chunk;
+
+// Hash key of a chunk or region position, x in the high half
+inline uint64_t get_chunk_key(glm::ivec2 pos)
+{
+    return ((uint64_t)(uint32_t)pos.x << 32) | (uint32_t)pos.y;
+}
+
+// Loaded chunks of the world by position, valid until the world vector
+// changes. Lookups only read the map, workers can share it.
+class ChunkMap
+{
+private:
+public:
+    std::unordered_map<uint64_t, Chunk*> chunks;
+
+    void set_world(std::vector<Chunk>& world);
+    // Null if the chunk is not loaded
+    Chunk* find(glm::ivec2 pos) const;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Vertex.hpp"
+
+// Render bucket of a block type, picked from its texture alpha
+enum BlockBucket
+{
+    BUCKET_OPAQUE,
+    BUCKET_CUTOUT,
+    BUCKET_TRANSLUCENT,
+    BUCKET_COUNT
+};
+
+struct ChunkMesh
+{
+    VkBuffer vk_vertex_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory vk_vertex_buffer_memory = VK_NULL_HANDLE;
+    VkBuffer vk_index_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory vk_index_buffer_memory = VK_NULL_HANDLE;
+
+    std::vector<Vertex> vertices{};
+    std::vector<uint32_t> indices{};
+    // Back to front order of indices, copied into vk_index_buffer with the
+    // next frame and emptied
+    std::vector<uint32_t> sorted_indices{};
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "Chunk.hpp"
+#include "ChunkMap.hpp"
+#include "WorldGenerator.hpp"
+#include "ChunkStorage.hpp"
+#include "ThreadPool.hpp"
+
+// Generates chunks on worker threads in stages. A chunk is decorated once it
+// has terrain, lit once its 8 neighbours are decorated (so every tree that
+// spills into it is known) and meshed once lit. Finished chunks are handed to
+// the world on the main thread, which uploads their buffers. Chunks saved
+// with their blocks are loaded instead of generated and already hold their
+// trees, saved edits are replayed after the decoration. Work is started
+// nearest first and each stage only gets a few milliseconds per frame, so
+// crossing into new chunks spreads over frames instead of stalling one.
+class ChunkPipeline
+{
+private:
+public:
+    enum Stage
+    {
+        STAGE_QUEUED,
+        STAGE_TERRAIN,
+        STAGE_DECORATED,
+        STAGE_LIT,
+        STAGE_MESHED,
+        // Moved into the world, only the decoration is kept
+        STAGE_LOADED,
+        STAGE_COUNT
+    };
+
+    struct Entry
+    {
+        glm::ivec2 pos;
+        std::unique_ptr<Chunk> chunk;
+        Stage stage = STAGE_QUEUED;
+        // A worker owns the chunk until its stage is done
+        bool busy = false;
+        bool from_disk = false;
+    };
+
+    WorldGenerator& generator;
+    ChunkStorage& storage;
+    // Set by the owner, light and mesh run on workers, get_lod and upload on
+    // the main thread
+    std::function<void(Chunk&)> light;
+    std::function<void(Chunk&)> mesh;
+    std::function<int(int)> get_lod;
+    std::function<void(Chunk&)> upload;
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    // Blocks placed by the decoration of each chunk, including the ones that
+    // spill into its neighbours
+    std::unordered_map<uint64_t, std::vector<DecorationBlock>> decorations;
+    std::array<size_t, STAGE_COUNT> stage_counts{};
+
+    // Chunks within render_distance of either center are meshed and kept in
+    // the world, the first center is the player's chunk and the second where
+    // the player is heading
+    std::array<glm::ivec2, 2> centers{};
+    int render_distance = 8;
+    // Horizontal view direction, chunks behind are scheduled as if they were
+    // view_weight chunks further away
+    glm::vec2 view_direction{0.0f, 0.0f};
+    float view_weight = 2.0f;
+
+    // Main thread milliseconds each stage may use per frame to start its
+    // work, the meshed stage's is for the hand-off and the upload
+    std::array<float, STAGE_COUNT> budget_ms{0.5f, 0.5f, 1.0f, 0.5f, 2.0f, 0.0f};
+    std::array<float, STAGE_COUNT> spent_ms{};
+    float update_ms = 0.0f;
+    float worst_update_ms = 0.0f;
+
+    ThreadPool pool;
+
+    bool neighbours_decorated(glm::ivec2 pos);
+    void load_terrain(glm::ivec2 pos, const ChunkRecord& record);
+    void start_stage(Entry& entry, int distance, int priority);
+    void finish_stage(glm::ivec2 pos, Stage stage);
+    void save_chunk(const Chunk& chunk);
+    // inner widens the area by that many chunks on the low side, for the
+    // decoration ring
+    bool in_area(glm::ivec2 pos, int inner);
+    bool in_meshed_area(glm::ivec2 pos);
+    Stage get_stage(glm::ivec2 pos);
+    size_t update(std::vector<Chunk>& world);
+
+    ChunkPipeline(WorldGenerator& generator, ChunkStorage& storage);
+    ~ChunkPipeline();
+};
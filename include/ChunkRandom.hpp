@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "ChunkMap.hpp"
+
+// Counter-based random numbers: the n-th value only depends on the world
+// seed, the chunk, the stream and n. Chunks get the same values whichever
+// thread generates them and in whatever order.
+struct ChunkRandom {
+    uint64_t key;
+    uint64_t counter = 0;
+
+    static uint64_t mix(uint64_t z) {
+        z += 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    ChunkRandom(uint32_t seed, glm::ivec2 chunk_pos, uint32_t stream = 0) {
+        key = mix(mix(seed) ^ mix(get_chunk_key(chunk_pos)) ^ ((uint64_t)stream << 32));
+    }
+
+    uint32_t at(uint64_t n) const {
+        return (uint32_t)(mix(key + n * 0x9e3779b97f4a7c15ull) >> 32);
+    }
+
+    uint32_t next() {
+        return at(counter++);
+    }
+
+    float next_float(float min, float max) {
+        return min + (next() >> 8) * (1.0f / 16777216.0f) * (max - min);
+    }
+};
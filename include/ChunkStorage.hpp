@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <glm/glm.hpp>
+
+#include "Chunk.hpp"
+#include "ChunkMap.hpp"
+#include "RegionFile.hpp"
+#include "ThreadPool.hpp"
+#include "IoService.hpp"
+
+// Edits of a chunk and the levels of its flowing fluids and, unless only the
+// edits are saved, its blocks along with the decoration it spills into its
+// neighbours, which are regenerated without it
+struct SavedChunk
+{
+    std::vector<uint16_t> types;
+    std::vector<DecorationBlock> decoration;
+    std::unordered_map<uint16_t, uint16_t> edits;
+    std::unordered_map<uint16_t, uint8_t> fluid_levels;
+};
+
+// What load_async found for a chunk: nothing, a save still in memory or a
+// record read from its region file
+struct ChunkRecord
+{
+    std::shared_ptr<const SavedChunk> saved;
+    std::vector<uint8_t> data;
+};
+
+// Edited chunks saved in region files. Records are read and written through
+// io, whose callbacks run when the main loop polls it. Decoding happens on
+// the chunk pipeline workers, saves are compressed and region files opened
+// on a thread of their own.
+class ChunkStorage
+{
+private:
+public:
+    std::string directory;
+    // Only keep what the player changed, chunks are regenerated from the
+    // seed and the edits replayed over them
+    bool save_edits_only = true;
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::unique_ptr<RegionFile>> regions;
+    // Regions found to have no file, until a save creates it
+    std::unordered_set<uint64_t> missing_regions;
+    // Saves not written yet, loads read them from here
+    std::unordered_map<uint64_t, std::shared_ptr<SavedChunk>> pending_saves;
+
+    size_t loaded_chunks = 0;
+    size_t saved_chunks = 0;
+    size_t saved_bytes = 0;
+    float decode_ms = 0.0f;
+
+    // Saves go after every chunk load
+    static const int SAVE_PRIORITY = 1 << 16;
+
+    IoService io;
+    ThreadPool pool{1};
+
+    void open(const std::string& directory);
+    // Null if the region has no file and create is false
+    RegionFile* get_region_file(glm::ivec2 chunk_pos, bool create);
+    // done gets the record of the chunk, it runs on the thread polling io,
+    // on the storage thread after opening a region or right away when there
+    // is nothing to read
+    void load_async(glm::ivec2 chunk_pos, int priority, std::function<void(ChunkRecord record)> done);
+    // Null if the chunk was never saved
+    std::shared_ptr<const SavedChunk> decode(glm::ivec2 chunk_pos, const ChunkRecord& record);
+    void flush();
+    void save(const Chunk& chunk, const std::vector<DecorationBlock>& decoration);
+
+    static void serialize(const SavedChunk& saved, std::vector<uint8_t>& data);
+    static bool deserialize(const std::vector<uint8_t>& data, SavedChunk& saved);
+
+    ChunkStorage();
+    ~ChunkStorage();
+};
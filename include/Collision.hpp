@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Chunk.hpp"
+#include "ChunkMap.hpp"
+
+struct Aabb
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Swept box collision against the blocks of the world. Moves are resolved
+// one axis at a time over every block layer the box sweeps through, so no
+// speed can tunnel through a block. Unloaded chunks and the bottom of the
+// world are solid, above the world is open.
+class VoxelCollider
+{
+private:
+public:
+    // Gap left between a blocked box and the block it ran into
+    static constexpr float SKIN = 0.001f;
+
+    std::vector<Chunk>& world;
+    // Built on the first lookup, kept with the last chunk until forget_chunk
+    // since the world vector changes between frames
+    ChunkMap chunks;
+    bool chunks_built = false;
+    // Chunk of the last block tested, null when it is not loaded
+    glm::ivec2 last_pos{0, 0};
+    Chunk* last_chunk = nullptr;
+    bool has_last = false;
+    size_t chunk_lookups = 0;
+
+    void forget_chunk();
+    bool is_solid(glm::ivec3 cell);
+    // Whether any block the box is in is solid
+    bool overlaps_block(const Aabb& box);
+    // How far the box can go along axis, up to delta
+    float sweep_axis(const Aabb& box, int axis, float delta);
+    // Moves the box by delta, y first, and returns the distance it went,
+    // blocked tells which axes ran into a block
+    glm::vec3 move(Aabb& box, glm::vec3 delta, glm::bvec3& blocked);
+
+    VoxelCollider(std::vector<Chunk>& world);
+};
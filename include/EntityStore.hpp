@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Chunk.hpp"
+#include "Collision.hpp"
+#include "ThreadPool.hpp"
+
+// Uniform grid of cubic cells hashed into a fixed number of buckets, rebuilt
+// every tick with a counting sort. Entities are filed by the cell of their
+// position only, queries widen the box by the largest half extent. Several
+// cells can share a bucket, so the results are candidates to test.
+class SpatialHash
+{
+private:
+public:
+    float cell_size;
+    size_t bucket_mask;
+    // Entities of bucket b are entries[bucket_start[b]] to
+    // entries[bucket_start[b + 1] - 1]
+    std::vector<uint32_t> bucket_start;
+    std::vector<uint32_t> entries;
+    std::vector<uint32_t> entity_buckets;
+
+    glm::ivec3 get_cell(glm::vec3 pos) const;
+    size_t get_bucket(glm::ivec3 cell) const;
+    void build(const float* x, const float* y, const float* z, size_t count);
+    // Appends the entities filed in a cell the box overlaps, once each
+    void query(glm::vec3 min, glm::vec3 max, std::vector<uint32_t>& found) const;
+
+    // bucket_count is rounded up to a power of two
+    SpatialHash(float cell_size, size_t bucket_count);
+};
+
+enum EntityType : uint16_t
+{
+    ENTITY_ITEM,
+    ENTITY_MOB
+};
+
+// Fixed capacity entity storage, one array per component like ParticlePool.
+// Positions are box centers, y points down like the world. Each tick the
+// mobs push each other apart through the spatial hash, then every entity
+// falls and is moved through the blocks by a VoxelCollider, both in batches
+// spread over a thread pool.
+class EntityStore
+{
+private:
+public:
+    static constexpr float GRAVITY = 0.02f;
+    static constexpr float TERMINAL_VELOCITY = 1.0f;
+    static constexpr float GROUND_FRICTION = 0.6f;
+    static constexpr float AIR_FRICTION = 0.91f;
+    // Velocity added per block of overlap between two mobs
+    static constexpr float SEPARATION = 0.05f;
+    // Entities handed to a worker at once
+    static const size_t BATCH_SIZE = 256;
+
+    size_t capacity;
+    size_t count = 0;
+
+    std::vector<float> pos_x;
+    std::vector<float> pos_y;
+    std::vector<float> pos_z;
+    std::vector<float> vel_x;
+    std::vector<float> vel_y;
+    std::vector<float> vel_z;
+    std::vector<float> half_x;
+    std::vector<float> half_y;
+    std::vector<float> half_z;
+    std::vector<uint16_t> type;
+    std::vector<uint8_t> on_ground;
+
+    SpatialHash grid{3.0f, 4096};
+    float max_half_extent = 0.0f;
+
+    // Cost of the last update
+    float hash_ms = 0.0f;
+    float physics_ms = 0.0f;
+    std::atomic<size_t> pair_tests{0};
+
+    bool spawn(EntityType entity_type, glm::vec3 pos, glm::vec3 half_extents, glm::vec3 velocity);
+    void remove(size_t index);
+    Aabb get_box(size_t index) const;
+    void separate(size_t begin, size_t end);
+    void move(size_t begin, size_t end, std::vector<Chunk>& world);
+    // Without a pool every batch runs on the calling thread
+    void update(std::vector<Chunk>& world, ThreadPool* pool);
+
+    EntityStore(size_t capacity);
+};
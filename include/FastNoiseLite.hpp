@@ -54,6 +54,10 @@
 
 class FastNoiseLite
 {
+    // Batched 16x16 evaluation and compile-time settings, see NoiseBatch.hpp and StaticNoise.hpp
+    friend class NoiseBatch;
+    template <typename Config> friend class StaticNoise;
+
 public:
     enum NoiseType
     {
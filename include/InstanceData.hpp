@@ -6,7 +6,7 @@ struct ParticleInstanceData
 {
     glm::vec3 pos;
     float size;
-    uint16_t block_type;
+    uint32_t block_type;
 
     static VkVertexInputBindingDescription get_binding_description() {
         VkVertexInputBindingDescription bindingDescription = {};
@@ -32,7 +32,7 @@ struct ParticleInstanceData
 
         attributeDescriptions[2].binding = 1;
         attributeDescriptions[2].location = 5;
-        attributeDescriptions[2].format = VK_FORMAT_R16_UINT;
+        attributeDescriptions[2].format = VK_FORMAT_R32_UINT;
         attributeDescriptions[2].offset = offsetof(ParticleInstanceData, block_type);
 
         return attributeDescriptions;
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+#if __has_include(<liburing.h>)
+#include <liburing.h>
+#define BASSICRAFT_IO_URING 1
+#else
+#define BASSICRAFT_IO_URING 0
+#endif
+
+// Asynchronous reads and writes at file offsets, through io_uring when
+// liburing is available and a few blocking threads otherwise. Requests wait
+// in a queue where the lowest priority goes first, reads of the same key
+// share one request and adjacent reads of a file are done as one. A request
+// waits for the earlier ones it overlaps when either is a write. The
+// callbacks run on the thread calling poll.
+class IoService
+{
+private:
+public:
+    // Reads get the bytes, writes an empty vector
+    using Callback = std::function<void(bool ok, std::vector<uint8_t>& data)>;
+
+    struct Request
+    {
+        bool is_write = false;
+        int fd = -1;
+        uint64_t offset = 0;
+        size_t size = 0;
+        std::vector<uint8_t> data;
+        int priority = 0;
+        uint64_t order = 0;
+        uint64_t key = 0;
+        std::vector<Callback> callbacks;
+        bool ok = false;
+    };
+
+    // What one read or write call covers
+    struct Batch
+    {
+        bool is_write = false;
+        int fd = -1;
+        uint64_t offset = 0;
+        std::vector<uint8_t> buffer;
+        std::vector<std::shared_ptr<Request>> requests;
+        bool ok = false;
+    };
+
+    static const size_t MAX_BATCH_SIZE = 256 * 1024;
+    static const unsigned QUEUE_DEPTH = 32;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<std::shared_ptr<Request>> queue;
+    // Requests of the batches being read or written
+    std::vector<std::shared_ptr<Request>> running;
+    std::unordered_map<uint64_t, std::shared_ptr<Request>> reads_by_key;
+    std::vector<std::unique_ptr<Batch>> completed;
+    size_t in_flight = 0;
+    uint64_t next_order = 0;
+    bool stopping = false;
+
+    size_t requests = 0;
+    size_t coalesced_requests = 0;
+    size_t merged_reads = 0;
+
+    bool use_io_uring = false;
+#if BASSICRAFT_IO_URING
+    struct io_uring ring;
+#endif
+    std::vector<std::thread> workers;
+
+    void read(int fd, uint64_t offset, size_t size, int priority, uint64_t key, Callback callback);
+    void write(int fd, uint64_t offset, std::vector<uint8_t> data, int priority, Callback callback);
+    size_t poll();
+    void wait();
+    size_t get_queued();
+
+    // Whether the two requests touch the same bytes and one is a write
+    static bool overlaps(const Request& a, const Request& b);
+    bool is_blocked(const Request& request);
+    // First request that can start, queue.end() if there is none
+    std::vector<std::shared_ptr<Request>>::iterator find_next();
+    std::unique_ptr<Batch> next_batch();
+    void finish_batch(std::unique_ptr<Batch> batch);
+    void run_batch(Batch& batch);
+    void worker_loop();
+
+    IoService(size_t thread_count = 2);
+    ~IoService();
+};
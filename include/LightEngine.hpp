@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Chunk.hpp"
+#include "ChunkMap.hpp"
+#include "ThreadPool.hpp"
+
+// Light to spread from a block, in world coordinates
+struct LightNode
+{
+    glm::ivec3 pos;
+    uint8_t level;
+};
+
+// Flood-fill sky and block light, 0 to 15 per block. Sky light is 15 in every
+// see-through block with open sky above it and goes straight down without
+// fading, both lights lose one level per block otherwise. Chunks are first
+// lit on their own by the pipeline, their borders are joined when they enter
+// the world and edits only relight the blocks whose light depended on them.
+class LightEngine
+{
+private:
+public:
+    enum Channel
+    {
+        CHANNEL_SKY,
+        CHANNEL_BLOCK,
+        CHANNEL_COUNT
+    };
+
+    // Read-only once set, the pipeline lights chunks from worker threads.
+    // Light goes through Chunk::see_through blocks.
+    std::array<uint8_t, 257> emission{};
+
+    ChunkMap chunks;
+    // Last chunk found in chunks, only used from the main thread
+    Chunk* last_chunk = nullptr;
+
+    // Cost of the last and worst block update
+    size_t last_nodes = 0;
+    float last_ms = 0.0f;
+    float worst_ms = 0.0f;
+    size_t relit_chunks = 0;
+
+    static uint8_t get_light(const Chunk& chunk, glm::ivec3 pos, int channel);
+    static void set_light(Chunk& chunk, glm::ivec3 pos, int channel, uint8_t level);
+    void set_world(std::vector<Chunk>& world);
+    // only limits the lookup to one chunk, without touching chunks
+    Chunk* resolve(glm::ivec3 pos, Chunk* only, glm::ivec3& local);
+    void mark_changed(Chunk* chunk, Chunk* only);
+    size_t propagate(std::vector<LightNode>& queue, int channel, Chunk* only);
+    size_t remove(std::vector<LightNode>& queue, std::vector<LightNode>& readd, int channel, Chunk* only);
+    void light_chunk(Chunk& chunk);
+    void stitch_chunk(Chunk& chunk);
+    void stitch_chunks(const std::vector<Chunk*>& stitched);
+    // Copies the light past each side of the chunk into its border_light,
+    // returns whether it changed since the chunk was meshed with it
+    bool copy_border_light(Chunk& chunk);
+    // Lights again the edited chunks and the ring around them on the pool
+    // and joins their borders, returns every relit chunk. The world must be
+    // set first.
+    std::vector<Chunk*> relight_chunks(const std::vector<Chunk*>& edited, ThreadPool& pool);
+    // Called once the block at pos changed from old_type, marks every chunk
+    // whose light changed with light_dirty
+    void update_block(glm::ivec3 pos, uint16_t old_type);
+
+    LightEngine();
+};
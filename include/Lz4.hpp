@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// LZ4 block format (no frame header), the caller stores the uncompressed size
+void lz4_compress(const uint8_t* src, size_t size, std::vector<uint8_t>& dst);
+// False if the data is corrupt or doesn't decompress to exactly size bytes
+bool lz4_decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t size);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "FastNoiseLite.hpp"
+
+// Evaluates a FastNoiseLite over the 16x16 columns of a chunk at once.
+// Only OpenSimplex2 with no fractal or FBm is vectorised, other settings
+// go through the scalar GetNoise. Results are bit-identical to GetNoise as
+// long as neither side is built with -ffast-math or FMA contraction.
+class NoiseBatch
+{
+private:
+    static void get_noise_grid_scalar(const FastNoiseLite& noise, float x0, float z0, float* out);
+    static void get_noise_grid_sse41(const FastNoiseLite& noise, float x0, float z0, float* out);
+    static void get_noise_grid_avx2(const FastNoiseLite& noise, float x0, float z0, float* out);
+    static bool is_vectorisable(const FastNoiseLite& noise);
+
+public:
+    static const int GRID_SIZE = 16;
+
+    enum SimdLevel
+    {
+        SimdLevel_Scalar,
+        SimdLevel_SSE41,
+        SimdLevel_AVX2
+    };
+
+    // out[x * 16 + z] = noise.GetNoise(x0 + x, z0 + z)
+    static void get_noise_grid(const FastNoiseLite& noise, float x0, float z0, float* out);
+    static void get_noise_grid(const FastNoiseLite& noise, float x0, float z0, float* out, SimdLevel level);
+    static SimdLevel get_simd_level();
+};
@@ -2,11 +2,23 @@
 
 #include <glm/glm.hpp>
 
+// Same layout as the std430 Particle struct of particles_shader.comp
 struct Particle {
     glm::vec3 position;
-    glm::vec3 velocity;
-    glm::vec3 color;
     float size;
+    glm::vec3 velocity;
     float life;
-    glm::vec3 offset{};
+    uint32_t block_type;
+    uint32_t padding[3];
+};
+
+struct ParticlePushConstants {
+    uint32_t src_command;
+    uint32_t dst_command;
+    uint32_t spawn_count;
+    uint32_t max_particles;
+    // Simulation ticks since the last dispatch, 0 only copies the particles
+    uint32_t steps;
+    // Fraction of a tick the frame is drawn at after the last one
+    float alpha;
 };
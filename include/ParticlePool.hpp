@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "Particle.hpp"
+#include "InstanceData.hpp"
+
+// Fixed capacity particle storage, one array per field so the update loops vectorise
+class ParticlePool
+{
+private:
+public:
+    size_t capacity;
+    size_t count = 0;
+
+    std::vector<float> pos_x;
+    std::vector<float> pos_y;
+    std::vector<float> pos_z;
+    std::vector<float> vel_x;
+    std::vector<float> vel_y;
+    std::vector<float> vel_z;
+    std::vector<float> size;
+    std::vector<float> life;
+    std::vector<uint32_t> block_type;
+
+    bool spawn(const Particle& particle);
+    void update();
+    void remove(size_t index);
+    // Positions alpha of the way from the previous tick to the last one
+    void write_instances(ParticleInstanceData* instances, float alpha);
+
+    ParticlePool(size_t capacity);
+    ~ParticlePool();
+};
@@ -4,6 +4,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "Collision.hpp"
+
 struct Camera {
     glm::vec3 pos;
     glm::vec3 front;
@@ -51,6 +53,11 @@ public:
         lastY = 0.0f;
     }
 
+    // 0.6 wide and 1.8 tall with the eye near the top, y points down
+    Aabb get_box() {
+        return {camera.pos + glm::vec3(-0.3f, -0.1f, -0.3f), camera.pos + glm::vec3(0.3f, 1.7f, 0.3f)};
+    }
+
     void processInput(GLFWwindow* window) {
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
             glfwSetWindowShouldClose(window, true);
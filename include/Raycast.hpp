@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Chunk.hpp"
+
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float max_distance;
+};
+
+struct RaycastHit
+{
+    bool hit = false;
+    // World position of the first non-air block, the normal of the face the
+    // ray entered it through and the cell in front of that face
+    glm::ivec3 block{0, 0, 0};
+    glm::ivec3 normal{0, 0, 0};
+    glm::ivec3 adjacent{0, 0, 0};
+    float distance = 0.0f;
+    // Index in the world of the chunks holding block and adjacent, -1 when
+    // not loaded
+    int chunk_index = -1;
+    int adjacent_chunk_index = -1;
+};
+
+// Exact block traversal (Amanatides and Woo) over the world's chunks. The
+// chunk under the ray is only looked up again when the ray crosses into
+// another one.
+class Raycaster
+{
+private:
+public:
+    std::vector<Chunk>& world;
+    size_t chunk_lookups = 0;
+    // Last chunk found, only kept within one cast or cast_batch since the
+    // world vector changes between frames
+    glm::ivec2 last_pos{0, 0};
+    int last_index = -1;
+
+    int find_chunk(glm::ivec2 pos);
+    RaycastHit trace(const Ray& ray);
+    RaycastHit cast(const Ray& ray);
+    // Line of sight and picking for many rays at once, rays starting in the
+    // same chunk share its lookup
+    std::vector<RaycastHit> cast_batch(const std::vector<Ray>& rays);
+
+    Raycaster(std::vector<Chunk>& world);
+};
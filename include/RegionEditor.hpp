@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "Chunk.hpp"
+#include "ChunkMap.hpp"
+
+// Blocks of a box copied out of the world, by (x * size.y + y) * size.z + z
+struct BlockRegion
+{
+    glm::ivec3 size{0, 0, 0};
+    std::vector<uint16_t> types;
+};
+
+// Edits every block of a box at once. Blocks are changed chunk by chunk
+// without touching the meshes or the light, the chunks that changed are
+// collected in touched so the caller relights and remeshes each one once.
+// Boxes are inclusive and clipped to the world height, blocks in chunks
+// that are not loaded are skipped.
+class RegionEditor
+{
+private:
+public:
+    ChunkMap chunks;
+    // Chunks changed since the caller last cleared it, each once
+    std::vector<Chunk*> touched;
+
+    // Sets every block of the box to what edit(world pos, type) returns,
+    // returns how many changed
+    template <typename Edit>
+    size_t edit(glm::ivec3 min, glm::ivec3 max, Edit&& edit)
+    {
+        glm::ivec3 first = glm::min(min, max);
+        glm::ivec3 last = glm::max(min, max);
+        first.y = std::max(first.y, 0);
+        last.y = std::min(last.y, 99);
+        size_t changed = 0;
+
+        for (int chunk_x = first.x >> 4; chunk_x <= last.x >> 4; chunk_x++) {
+            for (int chunk_z = first.z >> 4; chunk_z <= last.z >> 4; chunk_z++) {
+                Chunk* chunk = chunks.find(glm::ivec2(chunk_x, chunk_z));
+                if (!chunk) {
+                    continue;
+                }
+                size_t chunk_changed = 0;
+                int x_end = std::min(last.x, chunk_x * 16 + 15);
+                int z_end = std::min(last.z, chunk_z * 16 + 15);
+                for (int x = std::max(first.x, chunk_x * 16); x <= x_end; x++) {
+                    for (int y = first.y; y <= last.y; y++) {
+                        for (int z = std::max(first.z, chunk_z * 16); z <= z_end; z++) {
+                            Cube& cube = chunk->blocks[x & 15][y][z & 15];
+                            uint16_t type = edit(glm::ivec3(x, y, z), cube.type);
+                            if (type == cube.type) {
+                                continue;
+                            }
+                            cube.type = type;
+                            glm::ivec3 local(x & 15, y, z & 15);
+                            chunk->record_edit(local, type);
+                            if (!chunk->fluid_levels.empty()) {
+                                chunk->fluid_levels.erase((local.x * 100 + local.y) * 16 + local.z);
+                            }
+                            chunk_changed++;
+                        }
+                    }
+                }
+                if (chunk_changed > 0 && std::find(touched.begin(), touched.end(), chunk) == touched.end()) {
+                    touched.push_back(chunk);
+                }
+                changed += chunk_changed;
+            }
+        }
+        return changed;
+    }
+
+    size_t fill(glm::ivec3 min, glm::ivec3 max, uint16_t type);
+    size_t replace(glm::ivec3 min, glm::ivec3 max, uint16_t from, uint16_t to);
+    // Blocks whose center is within radius of the center of the box
+    size_t sphere(glm::ivec3 min, glm::ivec3 max, uint16_t type);
+    BlockRegion copy(glm::ivec3 min, glm::ivec3 max) const;
+    // Puts the region with its first corner at origin, air in the region
+    // only clears blocks with include_air
+    size_t paste(const BlockRegion& region, glm::ivec3 origin, bool include_air);
+};
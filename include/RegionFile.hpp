@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// REGION_SIZE x REGION_SIZE chunks in one file. The first TABLE_SECTORS hold
+// a table with one entry per chunk (first sector << 8 | sector count, 0 if
+// absent), each chunk record is a 4 byte length, a compression byte and the
+// data, padded to whole sectors. Sectors are small so that edit-only records
+// take little room. The file only keeps the table and sector allocation,
+// records are read and written through IoService.
+class RegionFile
+{
+private:
+public:
+    static const int REGION_SIZE = 32;
+    static const size_t SECTOR_SIZE = 512;
+    static const size_t TABLE_SECTORS = REGION_SIZE * REGION_SIZE * 4 / SECTOR_SIZE;
+    static const uint8_t COMPRESSION_LZ4 = 1;
+
+    std::string path;
+    int fd = -1;
+
+    std::array<uint32_t, REGION_SIZE * REGION_SIZE> table{};
+    // Entries as they are in the file, their sectors stay used until a
+    // newer entry replaces them there
+    std::array<uint32_t, REGION_SIZE * REGION_SIZE> disk_table{};
+    std::vector<bool> used_sectors;
+    std::mutex mutex;
+
+    static glm::ivec2 get_region(glm::ivec2 chunk_pos);
+    static int get_index(glm::ivec2 chunk_pos);
+    static void make_record(const std::vector<uint8_t>& data, uint8_t compression, size_t sectors, std::vector<uint8_t>& record);
+    static bool parse_record(const std::vector<uint8_t>& record, std::vector<uint8_t>& data, uint8_t& compression);
+
+    // Byte range of the sectors holding the chunk, false if it has none
+    bool locate(glm::ivec2 chunk_pos, uint64_t& offset, size_t& size);
+    // Moves the chunk to free sectors that fit size bytes of data and
+    // returns its new table entry, to be written once the record is
+    uint32_t allocate(glm::ivec2 chunk_pos, size_t size);
+    void free_sectors(uint32_t entry);
+    // Whether the entry should be written now that its record was, false
+    // if the write failed or a newer save of the chunk was allocated since
+    bool record_written(glm::ivec2 chunk_pos, uint32_t entry, bool ok);
+    // Frees the sectors of the entry the written one replaced
+    void entry_written(glm::ivec2 chunk_pos, uint32_t entry);
+
+    RegionFile(const std::string& path);
+    ~RegionFile();
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "FastNoiseLite.hpp"
+
+// Settings of the noises built in the Bassicraft constructor
+struct TerrainNoiseConfig
+{
+    static constexpr FastNoiseLite::FractalType fractal_type = FastNoiseLite::FractalType_FBm;
+    static constexpr float frequency = 0.01f;
+    static constexpr int octaves = 3;
+    static constexpr float lacunarity = 2.0f;
+    static constexpr float gain = 0.5f;
+    static constexpr float weighted_strength = 0.0f;
+};
+
+struct BiomeNoiseConfig
+{
+    // GetNoise ignores domain warp fractal types, they only change DomainWarp
+    static constexpr FastNoiseLite::FractalType fractal_type = FastNoiseLite::FractalType_DomainWarpIndependent;
+    static constexpr float frequency = 0.02f;
+    static constexpr int octaves = 3;
+    static constexpr float lacunarity = 2.0f;
+    static constexpr float gain = 0.5f;
+    static constexpr float weighted_strength = 0.0f;
+};
+
+// OpenSimplex2 noise with the settings of Config fixed at compile time.
+// get_noise gives the same floats as FastNoiseLite::GetNoise configured
+// through configure(), without its per-sample switches.
+template <typename Config>
+class StaticNoise
+{
+private:
+    static constexpr float SQRT3 = 1.7320508075688772935274463415059f;
+    static constexpr float F2 = 0.5f * (SQRT3 - 1);
+    static constexpr float G2 = (3 - SQRT3) / 6;
+    static constexpr int PRIME_X = 501125321;
+    static constexpr int PRIME_Y = 1136930381;
+
+    // Same loop as FastNoiseLite::CalculateFractalBounding
+    static constexpr float fractal_bounding()
+    {
+        float gain = Config::gain < 0 ? -Config::gain : Config::gain;
+        float amp = gain;
+        float amp_fractal = 1.0f;
+        for (int i = 1; i < Config::octaves; i++) {
+            amp_fractal += amp;
+            amp *= gain;
+        }
+        return 1 / amp_fractal;
+    }
+
+    static constexpr bool is_fbm = Config::fractal_type == FastNoiseLite::FractalType_FBm;
+
+    static inline float grad(int seed, int x_primed, int y_primed, float xd, float yd)
+    {
+        int hash = (seed ^ x_primed ^ y_primed) * 0x27d4eb2d;
+        hash ^= hash >> 15;
+        hash &= 127 << 1;
+        return xd * FastNoiseLite::Lookup<float>::Gradients2D[hash] + yd * FastNoiseLite::Lookup<float>::Gradients2D[hash | 1];
+    }
+
+    static inline float simplex(int seed, float x, float y)
+    {
+        int i = x >= 0 ? (int)x : (int)x - 1;
+        int j = y >= 0 ? (int)y : (int)y - 1;
+        float xi = (float)(x - i);
+        float yi = (float)(y - j);
+
+        float t = (xi + yi) * G2;
+        float x0 = (float)(xi - t);
+        float y0 = (float)(yi - t);
+
+        i *= PRIME_X;
+        j *= PRIME_Y;
+
+        float a = 0.5f - x0 * x0 - y0 * y0;
+        float n0 = (a * a) * (a * a) * grad(seed, i, j, x0, y0);
+        n0 = a <= 0 ? 0 : n0;
+
+        float c = (float)(2 * (1 - 2 * G2) * (1 / G2 - 2)) * t + ((float)(-2 * (1 - 2 * G2) * (1 - 2 * G2)) + a);
+        float x2 = x0 + (2 * (float)G2 - 1);
+        float y2 = y0 + (2 * (float)G2 - 1);
+        float n2 = (c * c) * (c * c) * grad(seed, i + PRIME_X, j + PRIME_Y, x2, y2);
+        n2 = c <= 0 ? 0 : n2;
+
+        bool upper = y0 > x0;
+        float x1 = x0 + (upper ? (float)G2 : ((float)G2 - 1));
+        float y1 = y0 + (upper ? ((float)G2 - 1) : (float)G2);
+        float b = 0.5f - x1 * x1 - y1 * y1;
+        float n1 = (b * b) * (b * b) * grad(seed, upper ? i : i + PRIME_X, upper ? j + PRIME_Y : j, x1, y1);
+        n1 = b <= 0 ? 0 : n1;
+
+        return (n0 + n1 + n2) * 99.83685446303647f;
+    }
+
+public:
+    int seed;
+
+    static void configure(FastNoiseLite& noise)
+    {
+        noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+        noise.SetFrequency(Config::frequency);
+        noise.SetFractalType(Config::fractal_type);
+        noise.SetFractalOctaves(Config::octaves);
+        noise.SetFractalLacunarity(Config::lacunarity);
+        noise.SetFractalGain(Config::gain);
+        noise.SetFractalWeightedStrength(Config::weighted_strength);
+    }
+
+    inline float get_noise(float x, float y) const
+    {
+        x *= Config::frequency;
+        y *= Config::frequency;
+        float t = (x + y) * F2;
+        x += t;
+        y += t;
+
+        if constexpr (!is_fbm) {
+            return simplex(seed, x, y);
+        }
+
+        float sum = 0;
+        float amp = fractal_bounding();
+        for (int i = 0; i < Config::octaves; i++) {
+            float noise = simplex(seed + i, x, y);
+            sum += noise * amp;
+            // With no weighting FastNoiseLite multiplies amp by exactly 1
+            if constexpr (Config::weighted_strength != 0.0f) {
+                amp *= 1.0f + Config::weighted_strength * ((noise + 1 < 2 ? noise + 1 : 2) * 0.5f - 1.0f);
+            }
+
+            x *= Config::lacunarity;
+            y *= Config::lacunarity;
+            amp *= Config::gain;
+        }
+        return sum;
+    }
+
+    StaticNoise(int seed) : seed(seed) {}
+    StaticNoise(const FastNoiseLite& noise) : seed(noise.mSeed) {}
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+
+// Fixed set of worker threads running the task with the lowest priority
+// first, tasks with the same priority in submission order
+class ThreadPool
+{
+private:
+public:
+    struct Task
+    {
+        int priority;
+        uint64_t sequence;
+        std::function<void()> run;
+    };
+
+    std::vector<std::thread> workers;
+    // Heap ordered by earlier_first
+    std::vector<Task> tasks;
+    uint64_t next_sequence = 0;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::condition_variable idle_condition;
+    size_t running = 0;
+    bool stopping = false;
+
+    static bool earlier_first(const Task& a, const Task& b);
+    void submit(std::function<void()> task, int priority = 0);
+    size_t get_pending_tasks();
+    // Blocks until every submitted task has run
+    void wait();
+    // Runs batch(0) to batch(count - 1) on the workers and the calling
+    // thread, returns once they have all run
+    void run_batches(size_t count, const std::function<void(size_t)>& batch, int priority = 0);
+    void worker_loop();
+    // Drops the tasks not started yet and joins the workers once the ones
+    // running are done
+    void stop();
+
+    // 0 uses one thread per core but one, left for the render loop
+    ThreadPool(size_t thread_count = 0);
+    ~ThreadPool();
+};
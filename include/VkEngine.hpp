@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <array>
 
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
@@ -13,6 +14,7 @@
 #include "TextureDataStruct.hpp"
 #include "Particle.hpp"
 #include "InstanceData.hpp"
+#include "ParticlePool.hpp"
 
 class VkEngine
 {
@@ -35,6 +37,8 @@ private:
 
     VkPipelineLayout vk_pipeline_layout;
     VkPipeline vk_graphics_pipeline;
+    VkPipeline vk_cutout_graphics_pipeline;
+    VkPipeline vk_translucent_graphics_pipeline;
     VkPipelineLayout vk_particles_pipeline_layout;
     VkPipeline vk_particles_graphics_pipeline;
 
@@ -54,16 +58,37 @@ private:
 
     bool framebuffer_resized = false;
 
-    std::vector<Particle> particles{};
+    std::vector<Particle> pending_particles{};
+    uint32_t particles_spawn_count = 0;
     std::vector<Vertex> particles_vertices{};
     std::vector<uint32_t> particles_indices{};
-    std::vector<ParticleInstanceData> particles_instance_data{};
     VkBuffer vk_particles_vertex_buffer = VK_NULL_HANDLE;
     VkDeviceMemory vk_particles_vertex_buffer_memory = VK_NULL_HANDLE;
     VkBuffer vk_particles_index_buffer = VK_NULL_HANDLE;
     VkDeviceMemory vk_particles_index_buffer_memory = VK_NULL_HANDLE;
     VkBuffer vk_particles_instance_buffer = VK_NULL_HANDLE;
     VkDeviceMemory vk_particles_instance_buffer_memory = VK_NULL_HANDLE;
+    // Frame i writes the particles of storage buffer i and reads the other one
+    std::vector<VkBuffer> vk_particles_storage_buffers;
+    std::vector<VkDeviceMemory> vk_particles_storage_buffers_memory;
+    std::vector<VkBuffer> vk_particles_spawn_buffers;
+    std::vector<VkDeviceMemory> vk_particles_spawn_buffers_memory;
+    std::vector<void *> vk_particles_spawn_buffers_mapped;
+    std::vector<VkBuffer> vk_particles_cpu_instance_buffers;
+    std::vector<VkDeviceMemory> vk_particles_cpu_instance_buffers_memory;
+    std::vector<void *> vk_particles_cpu_instance_buffers_mapped;
+    VkBuffer vk_particles_indirect_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory vk_particles_indirect_buffer_memory = VK_NULL_HANDLE;
+    // Sorted translucent indices of each frame, grown when a frame needs more
+    std::vector<VkBuffer> vk_sort_staging_buffers;
+    std::vector<VkDeviceMemory> vk_sort_staging_buffers_memory;
+    std::vector<void *> vk_sort_staging_buffers_mapped;
+    std::vector<VkDeviceSize> sort_staging_sizes;
+
+    VkDescriptorSetLayout vk_particles_compute_descriptor_set_layout;
+    std::vector<VkDescriptorSet> vk_particles_compute_descriptor_sets;
+    VkPipelineLayout vk_particles_compute_pipeline_layout;
+    VkPipeline vk_particles_compute_pipeline;
 
 
     VkBuffer vk_uniform_buffer;
@@ -81,6 +106,8 @@ private:
     VkImage vk_texture_image;
     VkDeviceMemory vk_texture_image_memory;
     VkImageView vk_texture_image_view;
+    uint32_t vk_texture_mip_levels = 1;
+    std::array<uint8_t, 257> block_buckets{};
     VkSampler vk_texture_sampler;
 
     VkImage vk_depth_image;
@@ -88,6 +115,7 @@ private:
     VkImageView vk_depth_image_view;
 
     const int MAX_FRAMES_IN_FLIGHT = 2;
+    const uint32_t TEXTURE_LAYERS = 256;
 
 public:
     int width = 1920;
@@ -95,7 +123,20 @@ public:
     GLFWwindow *window;
     float frame_render_duration = 0.0f;
 
-    const int MAX_PARTICLES = 200;
+    const uint32_t MAX_PARTICLES = 100000;
+    const uint32_t MAX_PARTICLE_SPAWNS = 4096;
+
+    // false simulates new particles on the CPU in particle_pool instead of the compute shader
+    bool gpu_particles = true;
+    ParticlePool particle_pool{MAX_PARTICLES};
+    float particles_update_duration = 0.0f;
+    // Ticks to simulate the particles by in the next frame
+    uint32_t particle_ticks = 0;
+    // Fraction of a tick the next frame is drawn at after the last one, set
+    // with the interpolated camera
+    float particle_alpha = 1.0f;
+    // false presents without waiting for the vertical blank
+    bool vsync = true;
 
     void create_swapchain();
     void create_render_pass();
@@ -103,10 +144,12 @@ public:
     void create_vertex_buffer();
     void create_index_buffer();
     void create_all_graphics_pipelines();
-    void create_graphics_pipeline(VkPipeline& pipeline, VkPipelineLayout& pipeline_layout, const char* vert_path, const char* frag_path, const char* geom_path = nullptr);
+    void create_graphics_pipeline(VkPipeline& pipeline, VkPipelineLayout pipeline_layout, BlockBucket bucket, const char* vert_path, const char* frag_path, const char* geom_path = nullptr);
+    void destroy_all_graphics_pipelines();
     void create_command_pool();
     void create_command_buffers();
     void record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index, std::vector<Chunk>& world, Player& player);
+    void draw_chunk_mesh(VkCommandBuffer command_buffer, ChunkMesh& mesh);
     void create_uniform_buffers();
     void update_uniform_buffer(uint32_t current_image, Camera& camera);
     void create_descriptor_set_layout();
@@ -115,11 +158,12 @@ public:
     void create_sync_objects();
     void create_texture_image();
     void create_texture_image_view();
-    VkImageView create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags);
+    VkImageView create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_2D, uint32_t mip_levels = 1, uint32_t layer_count = 1);
     void create_texture_sampler();
-    void create_image(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& image_memory);
-    void transition_image_layout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout);
-    void copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+    void create_image(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& image_memory, uint32_t mip_levels = 1, uint32_t array_layers = 1);
+    void transition_image_layout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout, uint32_t mip_levels = 1, uint32_t layer_count = 1);
+    void copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layer_count = 1);
+    void generate_mipmaps(VkImage image, VkFormat format, int32_t width, int32_t height, uint32_t mip_levels, uint32_t layer_count);
     void create_depth_resources();
     VkFormat find_depth_format();
     VkFormat find_supported_format(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
@@ -135,15 +179,24 @@ public:
     VkCommandBuffer begin_single_time_commands();
     void end_single_time_commands(VkCommandBuffer command_buffer);
     void recreate_vertex_array();
-    void add_cube_to_vertices(Cube& cube, int up, int down, int left, int right, int front, int back, glm::vec2 chunk_pos, Chunk &chunk);
+    void add_cube_to_vertices(Cube& cube, int up, int down, int left, int right, int front, int back, glm::vec2 chunk_pos, Chunk &chunk, int scale = 1);
     void remove_cube_from_vertices(glm::vec3 pos, glm::vec2 chunk_pos, Chunk& chunk, Cube& cube);
+    bool is_face_visible(uint16_t type, uint16_t neighbour);
+    bool is_see_through(uint16_t type);
+    float get_light_brightness(uint8_t light);
     void remove_face(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, int i, int indice);
     void free_buffers_chunk(Chunk& chunk);
+    void destroy_buffers_chunk(Chunk& chunk);
     void wait_idle();
 
     void create_vertex_buffer_chunk(Chunk& chunk);
     void create_index_buffer_chunk(Chunk& chunk);
     void recreate_buffers_chunk(Chunk& chunk);
+    // One wait for the GPU however many chunks are replaced
+    void recreate_buffers_chunks(const std::vector<Chunk*>& chunks);
+    // Only sorts on the CPU, the indices are copied by record_translucent_sorts
+    void sort_translucent_faces(Chunk& chunk, glm::vec3 camera_pos);
+    void record_translucent_sorts(VkCommandBuffer command_buffer, std::vector<Chunk>& world);
 
     void create_inventory();
     bool LoadTextureFromFile(const char* filename, MyTextureData* tex_data);
@@ -151,8 +204,15 @@ public:
 
     void create_particles(glm::vec3 pos, uint16_t type, Player& player);
     void create_particles_buffers();
+    void create_particles_compute_buffers();
+    void create_particles_compute_descriptor_sets();
+    void create_particles_compute_pipeline();
+    void create_particles_cpu_buffers();
+    void tick_particles();
+    void set_vsync(bool enabled);
     void update_particles();
-    void create_particles_instance_buffers();
+    void upload_particle_spawns();
+    void record_particles_compute(VkCommandBuffer command_buffer);
     void create_graphics_pipeline_particles(VkPipeline& pipeline, VkPipelineLayout& pipeline_layout, const char* vert_path, const char* frag_path, const char* geom_path = nullptr);
 
     VkEngine();
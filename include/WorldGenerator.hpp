@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "FastNoiseLite.hpp"
+#include "ChunkRandom.hpp"
+
+// Column heights and biome of one chunk
+struct ChunkColumns
+{
+    std::array<int, 256> heights;
+    int biome;
+};
+
+// Noise fields and sampling settings shared by every Chunk::Chunk, the
+// noises are read-only once seeded and mutex guards the cache and stats so
+// chunks can be generated from worker threads. Settings the debug window
+// changes while chunks are generated are atomic.
+class WorldGenerator
+{
+private:
+public:
+    enum TerrainMode
+    {
+        TERRAIN_HEIGHTFIELD,
+        TERRAIN_DENSITY,
+        TERRAIN_MODE_COUNT
+    };
+
+    // Counters copied out under mutex
+    struct Stats
+    {
+        size_t height_samples;
+        int worst_height_error;
+        size_t height_error_columns;
+        std::array<float, TERRAIN_MODE_COUNT> generation_ms;
+    };
+
+    // Every noise seed and chunk random stream derives from this, see set_seed
+    uint32_t seed = 0;
+    FastNoiseLite noise;
+    FastNoiseLite biome_noise;
+    FastNoiseLite density_noise;
+    FastNoiseLite cave_noise;
+
+    std::atomic<TerrainMode> terrain_mode{TERRAIN_DENSITY};
+
+    // Height noise is sampled every height_step blocks (1, 2, 4, 8 or 16)
+    // and bilinearly interpolated in between, 1 samples every column
+    int height_step = 4;
+    // Also samples every column and counts interpolated heights that are
+    // more than max_height_error blocks off
+    std::atomic<bool> verify_heights{false};
+    int max_height_error = 1;
+    int worst_height_error = 0;
+    size_t height_error_columns = 0;
+    size_t height_samples = 0;
+
+    // Density terrain covers y 0 to DENSITY_DEPTH - 1, with both 3D noises
+    // sampled every DENSITY_STEP blocks and trilinearly interpolated
+    static const int DENSITY_DEPTH = 21;
+    static const int DENSITY_STEP = 4;
+    // A block is solid when (y - height) / density_squash + density noise > 0
+    float density_squash = 4.0f;
+    // Caves are carved where |cave noise| < cave_threshold, from cave_min_depth blocks under the heightfield
+    float cave_threshold = 0.08f;
+    int cave_min_depth = 2;
+
+    // Running average generation time of a chunk for each terrain mode
+    std::array<float, TERRAIN_MODE_COUNT> generation_ms{};
+    std::array<size_t, TERRAIN_MODE_COUNT> generated_chunks{};
+
+    // Least recently used ChunkColumns, kept for chunks that get unloaded and
+    // reloaded and for height queries outside the loaded world
+    size_t columns_cache_capacity = 4096;
+    std::list<std::pair<uint64_t, ChunkColumns>> columns_cache;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, ChunkColumns>>::iterator> columns_cache_index;
+    size_t columns_cache_hits = 0;
+    size_t columns_cache_misses = 0;
+    std::mutex mutex;
+
+    void set_seed(uint32_t seed);
+    ChunkRandom get_chunk_random(glm::ivec2 chunk_pos, uint32_t stream = 0);
+
+    ChunkColumns get_columns(glm::ivec2 chunk_pos);
+    int get_height(int x, int z);
+    void clear_columns_cache();
+    size_t get_columns_cache_size();
+    size_t get_columns_cache_memory();
+    float get_columns_cache_hit_rate();
+    Stats get_stats();
+
+    int get_biome(glm::vec2 chunk_pos);
+    void get_heights(glm::vec2 chunk_pos, std::array<int, 256>& heights);
+    void get_solid_blocks(glm::vec2 chunk_pos, const std::array<int, 256>& heights, std::array<bool, 16 * DENSITY_DEPTH * 16>& solid);
+    void record_generation_time(TerrainMode mode, float ms);
+
+    WorldGenerator();
+    ~WorldGenerator();
+};
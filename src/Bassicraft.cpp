@@ -2,6 +2,8 @@
 #include <iostream>
 #include <algorithm>
 #include <chrono>
+#include <thread>
+#include <limits>
 
 #include <glm/glm.hpp>
 
@@ -16,41 +18,52 @@
 #include "VkBootstrap.h"
 #include "Utils.hpp"
 
-Bassicraft::Bassicraft(/* args */)
+Bassicraft::Bassicraft(uint32_t seed)
 {
-    srand(time(NULL));
-
-    noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
-    noise.SetSeed(rand());
-    noise.SetFrequency(0.01f);
-    noise.SetFractalType(FastNoiseLite::FractalType_FBm);
-    noise.SetFractalOctaves(3);
-    noise.SetFractalLacunarity(2.0f);
-    noise.SetFractalGain(0.5f);
-
-    biome_noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
-    biome_noise.SetSeed(rand());
-    biome_noise.SetFrequency(0.02f);
-    biome_noise.SetFractalType(FastNoiseLite::FractalType_DomainWarpIndependent);
-    biome_noise.SetFractalOctaves(3);
-    biome_noise.SetFractalLacunarity(2.0f);
-    biome_noise.SetFractalGain(0.5f);
+    generator.set_seed(seed);
+    storage.open("saves/" + std::to_string(seed));
 
     init_engine();
     init_textures();
 
-    for (int x = -render_distance; x < render_distance; x++) {
-        for (int z = -render_distance; z < render_distance; z++) {
-            world.push_back(Chunk(glm::vec2(x, z), noise, biome_noise));
+    for (int type = 0; type < 257; type++) {
+        Chunk::see_through[type] = engine.is_see_through(type);
+    }
+    // Both water tiles flow, desert sand falls
+    block_updates.behaviour[206] = BlockUpdater::BEHAVIOUR_FLUID;
+    block_updates.behaviour[68] = BlockUpdater::BEHAVIOUR_FLUID;
+    block_updates.behaviour[19] = BlockUpdater::BEHAVIOUR_FALLING;
+
+    pipeline.light = [this](Chunk& chunk) { lighting.light_chunk(chunk); };
+    pipeline.mesh = [this](Chunk& chunk) { set_blocks_in_vertex_buffer(chunk); };
+    pipeline.get_lod = [this](int distance) { return get_chunk_lod(1, distance); };
+    pipeline.upload = [this](Chunk& chunk) {
+        lighting.set_world(world);
+        lighting.stitch_chunk(chunk);
+        // Meshed before its neighbours' light was known
+        if (lighting.copy_border_light(chunk)) {
+            chunk.light_dirty = true;
+        }
+        mark_border_light_changes(chunk);
+        // Fluids saved while flowing carry on where they stopped
+        for (auto& [index, level] : chunk.fluid_levels) {
+            glm::ivec3 local(index / 1600, index / 16 % 100, index % 16);
+            block_updates.schedule(glm::ivec3(chunk.pos.x * 16, 0, chunk.pos.y * 16) + local, block_updates.delays[BlockUpdater::BEHAVIOUR_FLUID]);
         }
-    }
-
-    std::cout << "engine created\n";
-    for (auto& chunk : world) {
-        set_blocks_in_vertex_buffer(chunk);
         engine.create_vertex_buffer_chunk(chunk);
         engine.create_index_buffer_chunk(chunk);
+        translucent_sort_dirty = true;
+    };
+
+    std::cout << "engine created\n";
+    // The chunks around the spawn are all there for the first frame
+    while (world.size() < (size_t)(4 * render_distance * render_distance)) {
+        unload_load_new_chunks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+    // Feet on the first solid block of the spawn column
+    player.camera.pos.y = get_surface_y((int)floor(player.camera.pos.x), (int)floor(player.camera.pos.z)) - 2.0f;
+    previous_camera_pos = player.camera.pos;
 
     glfwSetWindowUserPointer(engine.window, this);
     glfwSetMouseButtonCallback(engine.window, [](GLFWwindow* window, int button, int action, int mods) {
@@ -60,8 +73,12 @@ Bassicraft::Bassicraft(/* args */)
         static_cast<Bassicraft*>(glfwGetWindowUserPointer(window))->key_callback(window, key, scancode, action, mods);
     });
 
+    auto last_time_point = std::chrono::high_resolution_clock::now();
     while (!glfwWindowShouldClose(engine.window)) {
         auto time_point = std::chrono::high_resolution_clock::now();
+        double elapsed = std::chrono::duration<double>(time_point - last_time_point).count();
+        last_time_point = time_point;
+        tick_accumulator = std::min(tick_accumulator + elapsed * time_scale, max_ticks_per_frame * TICK_SECONDS);
         glfwPollEvents();
         ImGui_ImplGlfw_MouseButtonCallback(engine.window, 0, GLFW_MOUSE_BUTTON_LEFT, GLFW_PRESS);
 
@@ -77,9 +94,110 @@ Bassicraft::Bassicraft(/* args */)
         ImGui::NewFrame();
         ImGui::Begin("Debug", &open, ImGuiWindowFlags_AlwaysAutoResize);
         ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
+        ImGui::Text("Seed: %u", generator.seed);
         ImGui::Text("Frame Time: %.1f ms", engine.frame_render_duration);
+        size_t triangles = 0;
+        for (auto& chunk : world) {
+            for (auto& mesh : chunk.meshes) {
+                triangles += mesh.indices.size() / 3;
+            }
+        }
+        ImGui::Text("Chunk triangles: %zu", triangles);
+        ImGui::Checkbox("GPU particles", &engine.gpu_particles);
+        ImGui::Text("CPU particles: %zu (%.3f ms)", engine.particle_pool.count, engine.particles_update_duration);
+        WorldGenerator::Stats generator_stats = generator.get_stats();
+        bool verify_heights = generator.verify_heights;
+        if (ImGui::Checkbox("Verify terrain heights", &verify_heights)) {
+            generator.verify_heights = verify_heights;
+        }
+        ImGui::Text("Height samples: %zu, every %d blocks", generator_stats.height_samples, generator.height_step);
+        ImGui::Text("Worst height error: %d (%zu columns over %d)", generator_stats.worst_height_error, generator_stats.height_error_columns, generator.max_height_error);
+        bool density_terrain = generator.terrain_mode == WorldGenerator::TERRAIN_DENSITY;
+        if (ImGui::Checkbox("Density terrain and caves", &density_terrain)) {
+            generator.terrain_mode = density_terrain ? WorldGenerator::TERRAIN_DENSITY : WorldGenerator::TERRAIN_HEIGHTFIELD;
+        }
+        ImGui::Text("Chunk generation: heightfield %.3f ms, density %.3f ms", generator_stats.generation_ms[WorldGenerator::TERRAIN_HEIGHTFIELD], generator_stats.generation_ms[WorldGenerator::TERRAIN_DENSITY]);
+        ImGui::Checkbox("Save edits only", &storage.save_edits_only);
+        ImGui::Text("Saved chunks: %zu written (%.1f KB), %zu loaded, decoded in %.3f ms each", storage.saved_chunks, storage.saved_bytes / 1024.0f, storage.loaded_chunks, storage.decode_ms);
+        ImGui::Text("World I/O (%s): %zu queued, %zu requests, %zu coalesced, %zu merged", storage.io.use_io_uring ? "io_uring" : "threads", storage.io.get_queued(), storage.io.requests, storage.io.coalesced_requests, storage.io.merged_reads);
+        ImGui::Text("Heightmap cache: %zu chunks, %.1f KB, %.1f%% hits", generator.get_columns_cache_size(), generator.get_columns_cache_memory() / 1024.0f, generator.get_columns_cache_hit_rate() * 100.0f);
+        ImGui::SliderInt("Prefetch ticks", &prefetch_ticks, 0, 120);
+        ImGui::Text("Visible unloaded chunks: %d, in %.1f%% of frames", visible_unloaded_chunks, counted_frames == 0 ? 0.0f : 100.0f * frames_with_unloaded_chunks / counted_frames);
+        ImGui::Text("Chunk pipeline: %zu queued, %zu terrain, %zu decorated, %zu lit, %zu meshed, %zu tasks", pipeline.stage_counts[ChunkPipeline::STAGE_QUEUED], pipeline.stage_counts[ChunkPipeline::STAGE_TERRAIN], pipeline.stage_counts[ChunkPipeline::STAGE_DECORATED], pipeline.stage_counts[ChunkPipeline::STAGE_LIT], pipeline.stage_counts[ChunkPipeline::STAGE_MESHED], pipeline.pool.get_pending_tasks());
+        ImGui::Text("Chunk updates: %.2f ms, worst %.2f ms (upload %.2f ms)", pipeline.update_ms, pipeline.worst_update_ms, pipeline.spent_ms[ChunkPipeline::STAGE_MESHED]);
+        ImGui::SliderFloat("Upload budget (ms)", &pipeline.budget_ms[ChunkPipeline::STAGE_MESHED], 0.1f, 16.0f);
+        ImGui::Text("Light update: %zu nodes, %.3f ms (worst %.3f ms), %zu chunks relit", lighting.last_nodes, lighting.last_ms, lighting.worst_ms, lighting.relit_chunks);
+        ImGui::Text("Ticks: %zu at %.0f Hz", ticks, 1.0 / TICK_SECONDS);
+        ImGui::SliderFloat("Time scale", &time_scale, 0.0f, 4.0f);
+        ImGui::SliderInt("Max ticks per frame", &max_ticks_per_frame, 1, 60);
+        if (ImGui::Button("Fast-forward 10 s")) {
+            simulate((int)(10.0 / TICK_SECONDS));
+        }
+        bool vsync = engine.vsync;
+        if (ImGui::Checkbox("VSync", &vsync)) {
+            engine.set_vsync(vsync);
+        }
+        ImGui::Text("Block updates: %zu run, %zu changes, %.3f ms, %zu pending in %zu sections", block_updates.last_updates, block_updates.last_changes, block_updates.last_ms, block_updates.get_pending(), block_updates.active.size());
+        ImGui::InputInt3("Region min", &region_min.x);
+        ImGui::InputInt3("Region max", &region_max.x);
+        if (ImGui::Button("Region around player")) {
+            glm::ivec3 feet = glm::floor(player.camera.pos);
+            region_min = feet - glm::ivec3(50, 50, 50);
+            region_max = feet + glm::ivec3(49, 49, 49);
+        }
+        ImGui::InputInt("Region block", &region_type);
+        ImGui::InputInt("Replaced block", &region_replaced_type);
+        region_type = std::clamp(region_type, 0, 256);
+        region_replaced_type = std::clamp(region_replaced_type, 0, 256);
+        bool fill = ImGui::Button("Fill");
+        ImGui::SameLine();
+        bool replace = ImGui::Button("Replace");
+        ImGui::SameLine();
+        bool sphere = ImGui::Button("Sphere");
+        ImGui::SameLine();
+        bool copy = ImGui::Button("Copy");
+        ImGui::SameLine();
+        bool paste = ImGui::Button("Paste at player") && !clipboard.types.empty();
+        ImGui::SameLine();
+        ImGui::Checkbox("With air", &paste_air);
+        if (fill || replace || sphere || paste) {
+            auto start = std::chrono::high_resolution_clock::now();
+            region_editor.chunks.set_world(world);
+            glm::ivec3 min = region_min;
+            glm::ivec3 max = region_max;
+            if (fill) {
+                region_blocks = region_editor.fill(min, max, region_type);
+            } else if (replace) {
+                region_blocks = region_editor.replace(min, max, region_replaced_type, region_type);
+            } else if (sphere) {
+                region_blocks = region_editor.sphere(min, max, region_type);
+            } else {
+                min = glm::floor(player.camera.pos);
+                max = min + clipboard.size - 1;
+                region_blocks = region_editor.paste(clipboard, min, paste_air);
+            }
+            finish_region_edit(min, max);
+            region_ms = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+        if (copy) {
+            region_editor.chunks.set_world(world);
+            clipboard = region_editor.copy(region_min, region_max);
+        }
+        ImGui::Text("Region edit: %zu blocks, %zu chunks remeshed, %.3f ms, clipboard %d x %d x %d", region_blocks, region_chunks, region_ms, clipboard.size.x, clipboard.size.y, clipboard.size.z);
+        ImGui::Text("Entities: %zu, hash %.3f ms, physics %.3f ms, %zu pair tests", entities.count, entities.hash_ms, entities.physics_ms, (size_t)entities.pair_tests);
+        if (ImGui::Button("Drop 1000 test entities")) {
+            for (int i = 0; i < 1000; i++) {
+                glm::vec3 offset(rand_float(-16.0f, 16.0f), rand_float(-8.0f, -2.0f), rand_float(-16.0f, 16.0f));
+                if (i % 2 == 0) {
+                    entities.spawn(ENTITY_ITEM, player.camera.pos + offset, glm::vec3(0.125f), glm::vec3(0.0f));
+                } else {
+                    entities.spawn(ENTITY_MOB, player.camera.pos + offset, glm::vec3(0.3f, 0.9f, 0.3f), glm::vec3(0.0f));
+                }
+            }
+        }
         ImGui::Text("Player position: %.1f %.1f %.1f", player.camera.pos.x, player.camera.pos.y, player.camera.pos.z);
-        ImGui::Text("Player chunk: %d %d", (int)player.camera.pos.x / 16, (int)player.camera.pos.z / 16);
+        glm::ivec2 player_chunk = get_player_chunk();
+        ImGui::Text("Player chunk: %d %d", player_chunk.x, player_chunk.y);
         ImGui::Text("Player chunk position: %.1f %.1f", regular_modulo(player.camera.pos.x, 16), regular_modulo(player.camera.pos.z, 16));
         ImGui::Text("Player yaw: %.1f", player.camera.yaw);
         ImGui::Text("Player pitch: %.1f", player.camera.pitch);
@@ -100,18 +218,29 @@ Bassicraft::Bassicraft(/* args */)
         ImGui::Render();
 
         unload_load_new_chunks();
+        update_chunks_lod();
+        remesh_dirty_chunks();
+        sort_translucent_chunks();
+        while (tick_accumulator >= TICK_SECONDS) {
+            tick();
+            tick_accumulator -= TICK_SECONDS;
+        }
+        // Looking around stays per frame, only movement waits for ticks
         if (is_cursor_locked) {
-            move_player();
             player.mouse_movement(engine.window);
         } else {
             player.update_mouse_pos(engine.window);
         }
 
-        engine.update_particles();
-
-        engine.draw_frame(player, world);
+        draw_interpolated();
         engine.frame_render_duration = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - time_point).count();
     }
+
+    for (auto& chunk : world) {
+        if (chunk.modified && !chunk.should_be_deleted) {
+            pipeline.save_chunk(chunk);
+        }
+    }
 }
 
 void Bassicraft::init_engine()
@@ -150,9 +279,16 @@ void Bassicraft::init_textures()
 
 void Bassicraft::set_blocks_in_vertex_buffer(Chunk& chunk)
 {
+    if (chunk.lod > 1) {
+        set_blocks_in_vertex_buffer_lod(chunk);
+        return;
+    }
     for (int x = 0; x < 16; x++) {
+        bool inner = x > 0 && x < 15;
         for (int y = 0; y < 100; y++) {
-            for (int z = 0; z < 16; z++) {
+            // Blocks of a buried layer only show faces on the chunk border
+            bool buried = inner && chunk.is_layer_buried(y);
+            for (int z = 0; z < 16; z += buried ? 15 : 1) {
                 if (chunk.blocks[x][y][z].type != 0) {
                     int up = 0;
                     int down = 0;
@@ -187,32 +323,338 @@ void Bassicraft::set_blocks_in_vertex_buffer(Chunk& chunk)
     }
 }
 
+void Bassicraft::set_blocks_in_vertex_buffer_lod(Chunk& chunk)
+{
+    // Faces on the chunk border are always emitted, which also covers the
+    // cracks against neighbours meshed at another LOD
+    int scale = chunk.lod;
+    int size_xz = 16 / scale;
+    int size_y = (100 + scale - 1) / scale;
+    std::vector<uint16_t> cells(size_xz * size_y * size_xz);
+
+    auto cell = [&](int x, int y, int z) -> int {
+        if (x < 0 || x >= size_xz || y < 0 || y >= size_y || z < 0 || z >= size_xz) {
+            return 0;
+        }
+        return cells[(x * size_y + y) * size_xz + z];
+    };
+
+    for (int x = 0; x < size_xz; x++) {
+        for (int y = 0; y < size_y; y++) {
+            for (int z = 0; z < size_xz; z++) {
+                cells[(x * size_y + y) * size_xz + z] = chunk.get_lod_block(x * scale, y * scale, z * scale, scale);
+            }
+        }
+    }
+    for (int x = 0; x < size_xz; x++) {
+        for (int y = 0; y < size_y; y++) {
+            for (int z = 0; z < size_xz; z++) {
+                int type = cell(x, y, z);
+                if (type == 0) {
+                    continue;
+                }
+                int up = cell(x, y - 1, z);
+                int down = cell(x, y + 1, z);
+                int left = cell(x - 1, y, z);
+                int right = cell(x + 1, y, z);
+                int front = cell(x, y, z - 1);
+                int back = cell(x, y, z + 1);
+                Cube cube{glm::ivec3(x * scale, y * scale, z * scale), (uint16_t)type};
+                engine.add_cube_to_vertices(cube, up, down, left, right, front, back, chunk.pos, chunk, scale);
+            }
+        }
+    }
+}
+
+void Bassicraft::rebuild_mesh(Chunk& chunk)
+{
+    for (auto& mesh : chunk.meshes) {
+        mesh.vertices.clear();
+        mesh.indices.clear();
+    }
+    for (int x = 0; x < 16; x++) {
+        for (int y = 0; y < 100; y++) {
+            for (int z = 0; z < 16; z++) {
+                chunk.blocks[x][y][z].pos = glm::ivec3(x, y, z);
+                chunk.blocks[x][y][z].faces = 0;
+                chunk.blocks[x][y][z].is_displayed = false;
+            }
+        }
+    }
+    set_blocks_in_vertex_buffer(chunk);
+}
+
+void Bassicraft::remesh_chunk(Chunk& chunk)
+{
+    lighting.set_world(world);
+    lighting.copy_border_light(chunk);
+    rebuild_mesh(chunk);
+    engine.recreate_buffers_chunk(chunk);
+    mark_border_light_changes(chunk);
+    // New meshes come with their translucent faces in mesh order
+    translucent_sort_dirty = true;
+}
+
+void Bassicraft::remesh_chunks(const std::vector<Chunk*>& chunks)
+{
+    if (chunks.empty()) {
+        return;
+    }
+    lighting.set_world(world);
+    for (Chunk* chunk : chunks) {
+        lighting.copy_border_light(*chunk);
+    }
+    pipeline.pool.run_batches(chunks.size(), [&](size_t i) { rebuild_mesh(*chunks[i]); }, std::numeric_limits<int>::min());
+    engine.recreate_buffers_chunks(chunks);
+    for (Chunk* chunk : chunks) {
+        chunk->light_dirty = false;
+        chunk->mesh_dirty = false;
+    }
+    for (Chunk* chunk : chunks) {
+        mark_border_light_changes(*chunk);
+    }
+    translucent_sort_dirty = true;
+}
+
+void Bassicraft::mark_border_light_changes(Chunk& chunk)
+{
+    // Neighbours meshed with other light on their side facing the chunk
+    static const glm::ivec2 SIDES[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (glm::ivec2 side : SIDES) {
+        Chunk* found = lighting.chunks.find(glm::ivec2(chunk.pos) + side);
+        if (found && lighting.copy_border_light(*found)) {
+            found->light_dirty = true;
+        }
+    }
+}
+
+int Bassicraft::get_chunk_lod(int current_lod, int distance)
+{
+    int lod = 1;
+    for (int threshold : lod_distances) {
+        if (distance >= threshold) {
+            lod *= 2;
+        }
+    }
+    // Only go back to a finer mesh once the chunk is one chunk inside the
+    // threshold, so walking along a boundary doesn't remesh every frame
+    if (lod < current_lod) {
+        lod = 1;
+        for (int threshold : lod_distances) {
+            if (distance + 1 >= threshold) {
+                lod *= 2;
+            }
+        }
+    }
+    return lod;
+}
+
+glm::ivec2 Bassicraft::get_player_chunk()
+{
+    // Floored so the chunks at negative coordinates are not off by one
+    glm::ivec2 block((int)floor(player.camera.pos.x), (int)floor(player.camera.pos.z));
+    return glm::ivec2(block.x >> 4, block.y >> 4);
+}
+
+void Bassicraft::update_chunks_lod()
+{
+    glm::vec2 player_chunk = glm::vec2(get_player_chunk());
+    std::vector<Chunk*> rebuilt;
+
+    // Refine chunks coming closer before coarsening the ones moving away
+    for (int pass = 0; pass < 2; pass++) {
+        for (auto& chunk : world) {
+            if (chunk.should_be_deleted || (int)rebuilt.size() >= max_lod_rebuilds_per_frame) {
+                continue;
+            }
+            int distance = std::max(abs(chunk.pos.x - player_chunk.x), abs(chunk.pos.y - player_chunk.y));
+            int lod = get_chunk_lod(chunk.lod, distance);
+            if ((pass == 0 && lod < chunk.lod) || (pass == 1 && lod > chunk.lod)) {
+                chunk.lod = lod;
+                rebuilt.push_back(&chunk);
+            }
+        }
+    }
+    remesh_chunks(rebuilt);
+}
+
+void Bassicraft::update_light(Chunk& chunk, glm::ivec3 pos, uint16_t old_type)
+{
+    chunk.update_heightmap(pos, old_type);
+    lighting.set_world(world);
+    lighting.update_block(glm::ivec3(chunk.pos.x * 16 + pos.x, pos.y, chunk.pos.y * 16 + pos.z), old_type);
+    // The edited chunk gets its new light right away, the other relit
+    // chunks within the per-frame remesh budget
+    if (chunk.light_dirty) {
+        chunk.light_dirty = false;
+        remesh_chunk(chunk);
+    } else {
+        engine.recreate_buffers_chunk(chunk);
+    }
+}
+
+void Bassicraft::schedule_block_updates(Chunk& chunk, glm::ivec3 pos)
+{
+    // A placed block is a source or still, whatever was there before
+    chunk.fluid_levels.erase((pos.x * 100 + pos.y) * 16 + pos.z);
+    block_updates.chunks.set_world(world);
+    block_updates.schedule_around(glm::ivec3(chunk.pos.x * 16 + pos.x, pos.y, chunk.pos.y * 16 + pos.z));
+}
+
+void Bassicraft::finish_region_edit(glm::ivec3 min, glm::ivec3 max)
+{
+    lighting.set_world(world);
+    std::vector<Chunk*> relit = lighting.relight_chunks(region_editor.touched, pipeline.pool);
+    remesh_chunks(relit);
+
+    // Fluids and falling blocks on either side of the faces of the box
+    block_updates.chunks.set_world(world);
+    glm::ivec3 first = glm::min(min, max);
+    glm::ivec3 last = glm::max(min, max);
+    for (int x = first.x - 1; x <= last.x + 1; x++) {
+        for (int y = std::max(first.y - 1, 0); y <= std::min(last.y + 1, 99); y++) {
+            bool x_face = x < first.x || x > last.x;
+            bool y_face = y < first.y || y > last.y;
+            for (int z = first.z - 1; z <= last.z + 1; z += x_face || y_face ? 1 : last.z - first.z + 2) {
+                block_updates.schedule_around(glm::ivec3(x, y, z));
+            }
+        }
+    }
+
+    region_chunks = relit.size();
+    region_editor.touched.clear();
+}
+
+int Bassicraft::get_surface_y(int x, int z)
+{
+    glm::vec2 chunk_pos = glm::vec2(x >> 4, z >> 4);
+    for (auto& chunk : world) {
+        if (chunk.pos == chunk_pos && !chunk.should_be_deleted) {
+            return chunk.get_surface(x & 15, z & 15);
+        }
+    }
+    return 100;
+}
+
+void Bassicraft::remesh_dirty_chunks()
+{
+    int rebuilt = 0;
+    size_t count = world.size();
+    for (size_t i = 0; i < count && rebuilt < max_remeshes_per_frame; i++) {
+        size_t index = (remesh_start + i) % count;
+        Chunk& chunk = world[index];
+        if ((chunk.light_dirty || chunk.mesh_dirty) && !chunk.should_be_deleted) {
+            chunk.light_dirty = false;
+            chunk.mesh_dirty = false;
+            remesh_chunk(chunk);
+            rebuilt++;
+            remesh_start = index + 1;
+        }
+    }
+}
+
+void Bassicraft::run_block_updates()
+{
+    if (block_updates.active.empty()) {
+        return;
+    }
+    std::vector<BlockChange> applied;
+    block_updates.chunks.set_world(world);
+    block_updates.update(&pipeline.pool, applied);
+    if (applied.empty()) {
+        return;
+    }
+    // Meshes follow within the remesh budget instead of one rebuild per block
+    lighting.set_world(world);
+    for (auto& change : applied) {
+        glm::ivec3 local;
+        Chunk* chunk = block_updates.resolve(change.pos, local);
+        chunk->update_heightmap(local, change.expected);
+        lighting.update_block(change.pos, change.expected);
+        chunk->mesh_dirty = true;
+    }
+    translucent_sort_dirty = true;
+}
+
+void Bassicraft::sort_translucent_chunks()
+{
+    // Faces inside far chunks are small enough on screen to skip sorting
+    glm::ivec3 block = glm::floor(player.camera.pos);
+    if (block == last_sort_block && !translucent_sort_dirty) {
+        return;
+    }
+    last_sort_block = block;
+    translucent_sort_dirty = false;
+
+    glm::vec2 player_chunk = glm::vec2(get_player_chunk());
+    for (auto& chunk : world) {
+        if (chunk.should_be_deleted || std::max(abs(chunk.pos.x - player_chunk.x), abs(chunk.pos.y - player_chunk.y)) > 1) {
+            continue;
+        }
+        engine.sort_translucent_faces(chunk, player.camera.pos);
+    }
+}
+
 void Bassicraft::unload_load_new_chunks()
 {
-    glm::vec2 player_chunk = glm::vec2((int)player.camera.pos.x / 16, (int)player.camera.pos.z / 16);
+    glm::vec3 ahead = player.camera.pos + player.velocity * (float)prefetch_ticks;
+    glm::vec2 front = glm::vec2(player.camera.front.x, player.camera.front.z);
+    glm::ivec2 ahead_block((int)floor(ahead.x), (int)floor(ahead.z));
+    pipeline.centers = {get_player_chunk(), glm::ivec2(ahead_block.x >> 4, ahead_block.y >> 4)};
+    pipeline.view_direction = glm::length(front) > 0.001f ? glm::normalize(front) : glm::vec2(0.0f);
+    pipeline.render_distance = render_distance;
+
     for (auto& chunk : world) {
-        if (chunk.pos.x < player_chunk.x - render_distance || chunk.pos.x > player_chunk.x + render_distance || chunk.pos.y < player_chunk.y - render_distance || chunk.pos.y > player_chunk.y + render_distance) {
+        if (chunk.should_be_deleted) {
+            continue;
+        }
+        if (!pipeline.in_area(glm::ivec2(chunk.pos), 0)) {
             chunk.should_be_deleted = true;
+            if (chunk.modified) {
+                pipeline.save_chunk(chunk);
+            }
         }
     }
+    storage.io.poll();
+    pipeline.update(world);
+
+    visible_unloaded_chunks = count_visible_unloaded_chunks();
+    counted_frames++;
+    if (visible_unloaded_chunks > 0) {
+        frames_with_unloaded_chunks++;
+    }
+}
+
+int Bassicraft::count_visible_unloaded_chunks()
+{
+    glm::vec2 front = glm::vec2(player.camera.front.x, player.camera.front.z);
+    if (glm::length(front) < 0.001f || height == 0) {
+        return 0;
+    }
+    front = glm::normalize(front);
+    float half_fov = atanf(tanf(glm::radians(player.camera.fov) / 2) * width / height);
+    glm::vec2 eye(player.camera.pos.x, player.camera.pos.z);
+    glm::ivec2 player_chunk = pipeline.centers[0];
+    int count = 0;
+
     for (int x = -render_distance; x < render_distance; x++) {
         for (int z = -render_distance; z < render_distance; z++) {
-            bool found = false;
-            for (auto& chunk : world) {
-                if (chunk.pos == glm::vec2(player_chunk.x + x, player_chunk.y + z)) {
-                    found = true;
-                    break;
+            glm::ivec2 pos = player_chunk + glm::ivec2(x, z);
+            glm::vec2 to_chunk = glm::vec2(pos) * 16.0f + 8.0f - eye;
+            float distance = glm::length(to_chunk);
+            // Widen the cone by the angle of the chunk's half diagonal
+            if (distance > 12.0f) {
+                float angle = acosf(std::clamp(glm::dot(to_chunk / distance, front), -1.0f, 1.0f));
+                if (angle > half_fov + asinf(12.0f / distance)) {
+                    continue;
                 }
             }
-            if (!found) {
-                int siz = world.size();
-                world.push_back(Chunk(glm::vec2(player_chunk.x + x, player_chunk.y + z), noise, biome_noise));
-                set_blocks_in_vertex_buffer(world[siz]);
-                engine.create_vertex_buffer_chunk(world[siz]);
-                engine.create_index_buffer_chunk(world[siz]);
+            if (pipeline.get_stage(pos) != ChunkPipeline::STAGE_LOADED) {
+                count++;
             }
         }
     }
+    return count;
 }
 
 void Bassicraft::key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
@@ -264,9 +706,13 @@ void Bassicraft::mouse_buttons(GLFWwindow* window, int button, int action, int m
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
         glm::vec4 pos = get_cube_pointed_at(false);
         if (pos.w != -42069 && world[pos.w].blocks[pos.x][pos.y][pos.z].type != 0) {
+            uint16_t old_type = world[pos.w].blocks[pos.x][pos.y][pos.z].type;
             engine.create_particles(world[pos.w].blocks[pos.x][pos.y][pos.z].pos, world[pos.w].blocks[pos.x][pos.y][pos.z].type, player);
             remove_cube(world[pos.w], pos, world[pos.w].blocks[pos.x][pos.y][pos.z]);
-            engine.recreate_buffers_chunk(world[pos.w]);
+            world[pos.w].record_edit(glm::ivec3(pos.x, pos.y, pos.z), 0);
+            update_light(world[pos.w], pos, old_type);
+            schedule_block_updates(world[pos.w], pos);
+            translucent_sort_dirty = true;
         }
     }
     if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
@@ -280,7 +726,10 @@ void Bassicraft::mouse_buttons(GLFWwindow* window, int button, int action, int m
             }
             cube.pos = glm::ivec3(pos.x, pos.y, pos.z);
             add_cube(world[pos.w], cube);
-            engine.recreate_buffers_chunk(world[pos.w]);
+            world[pos.w].record_edit(glm::ivec3(pos.x, pos.y, pos.z), cube.type);
+            update_light(world[pos.w], pos, 0);
+            schedule_block_updates(world[pos.w], pos);
+            translucent_sort_dirty = true;
         }
     }
     if (button == GLFW_MOUSE_BUTTON_MIDDLE && action == GLFW_PRESS) {
@@ -296,7 +745,7 @@ void Bassicraft::add_cube(Chunk& chunk, Cube& cube)
     chunk.blocks[cube.pos.x][cube.pos.y][cube.pos.z] = cube;
     if (cube.pos.x == 0 || cube.pos.x == 15 || cube.pos.y == 0 || cube.pos.y == 99 || cube.pos.z == 0 || cube.pos.z == 15) {
         engine.add_cube_to_vertices(chunk.blocks[cube.pos.x][cube.pos.y][cube.pos.z], 0, 0, 0, 0, 0, 0, chunk.pos, chunk);
-    } else if (chunk.blocks[cube.pos.x - 1][cube.pos.y][cube.pos.z].type == 0 || chunk.blocks[cube.pos.x + 1][cube.pos.y][cube.pos.z].type == 0 || chunk.blocks[cube.pos.x][cube.pos.y - 1][cube.pos.z].type == 0 || chunk.blocks[cube.pos.x][cube.pos.y + 1][cube.pos.z].type == 0 || chunk.blocks[cube.pos.x][cube.pos.y][cube.pos.z - 1].type == 0 || chunk.blocks[cube.pos.x][cube.pos.y][cube.pos.z + 1].type == 0) {
+    } else if (engine.is_face_visible(cube.type, chunk.blocks[cube.pos.x - 1][cube.pos.y][cube.pos.z].type) || engine.is_face_visible(cube.type, chunk.blocks[cube.pos.x + 1][cube.pos.y][cube.pos.z].type) || engine.is_face_visible(cube.type, chunk.blocks[cube.pos.x][cube.pos.y - 1][cube.pos.z].type) || engine.is_face_visible(cube.type, chunk.blocks[cube.pos.x][cube.pos.y + 1][cube.pos.z].type) || engine.is_face_visible(cube.type, chunk.blocks[cube.pos.x][cube.pos.y][cube.pos.z - 1].type) || engine.is_face_visible(cube.type, chunk.blocks[cube.pos.x][cube.pos.y][cube.pos.z + 1].type)) {
         engine.add_cube_to_vertices(chunk.blocks[cube.pos.x][cube.pos.y][cube.pos.z], chunk.blocks[cube.pos.x][cube.pos.y - 1][cube.pos.z].type, chunk.blocks[cube.pos.x][cube.pos.y + 1][cube.pos.z].type, chunk.blocks[cube.pos.x - 1][cube.pos.y][cube.pos.z].type, chunk.blocks[cube.pos.x + 1][cube.pos.y][cube.pos.z].type, chunk.blocks[cube.pos.x][cube.pos.y][cube.pos.z - 1].type, chunk.blocks[cube.pos.x][cube.pos.y][cube.pos.z + 1].type, chunk.pos, chunk);
     }
 }
@@ -342,54 +791,16 @@ glm::vec4 Bassicraft::get_cube_pointed_at(bool for_placing)
     //Return vec (16, 100, 16) position in the chunk
     //Return -42069 if no cube is pointed at
 
-    glm::vec3 ray = player.camera.front;
-    glm::vec3 start = player.camera.pos;
-
-    for (float t = 0.0f; t < 10.0f; t += 0.01f) {
-        glm::vec3 position = start + ray * t;
-        glm::ivec3 block_position = glm::floor(position);
-        glm::vec2 chunk_pos = glm::vec2((int)block_position.x / 16, (int)block_position.z / 16);
-        glm::ivec3 block_position_in_chunk = glm::ivec3(regular_modulo(block_position.x, 16), block_position.y, regular_modulo(block_position.z, 16));
-
-        if (block_position.x < 0 && block_position_in_chunk.x != 0) {
-            chunk_pos.x--;
-        }
-        if (block_position.z < 0 && block_position_in_chunk.z != 0) {
-            chunk_pos.y--;
-        }
-        int index = 0;
-        for (auto& chunk : world) {
-            if (chunk.pos == chunk_pos) {
-                if (chunk.blocks[block_position_in_chunk.x][block_position_in_chunk.y][block_position_in_chunk.z].type != 0) {
-                    if (for_placing) {
-                        glm::ivec3 old_block = block_position;
-                        while (block_position == old_block) {
-                            position -= ray * 0.01f;
-                            block_position = glm::floor(position);
-                        }
-                        block_position_in_chunk = glm::ivec3(regular_modulo(block_position.x, 16), block_position.y, regular_modulo(block_position.z, 16));
-                        chunk_pos = glm::vec2((int)block_position.x / 16, (int)block_position.z / 16);
-                        if (block_position.x < 0 && block_position_in_chunk.x != 0) {
-                            chunk_pos.x--;
-                        }                            
-                        if (block_position.z < 0 && block_position_in_chunk.z != 0) {
-                            chunk_pos.y--;
-                        }
-                        index = 0;
-                        for (auto& chunk : world) {
-                            if (chunk.pos == chunk_pos) {
-                                return glm::vec4(block_position_in_chunk, index);
-                            }
-                            index++;
-                        }
-                    }
-                    return glm::vec4(block_position_in_chunk, index);
-                }
-            }
-            index++;
-        }
+    RaycastHit hit = raycaster.cast({player.camera.pos, player.camera.front, 10.0f});
+    if (!hit.hit) {
+        return glm::vec4(0, 0, 0, -42069);
     }
-    return glm::vec4(0, 0, 0, -42069);
+    glm::ivec3 block = for_placing ? hit.adjacent : hit.block;
+    int index = for_placing ? hit.adjacent_chunk_index : hit.chunk_index;
+    if (index == -1 || block.y < 0 || block.y >= 100) {
+        return glm::vec4(0, 0, 0, -42069);
+    }
+    return glm::vec4(block.x & 15, block.y, block.z & 15, index);
 }
 
 void Bassicraft::display_hotbar()
@@ -479,29 +890,24 @@ void Bassicraft::move_player()
         player.velocity.x += glm::normalize(glm::cross(player.camera.front, player.camera.up)).x * player.camera.speed;
         player.velocity.z += glm::normalize(glm::cross(player.camera.front, player.camera.up)).z * player.camera.speed;
     }
-    if (glfwGetKey(engine.window, GLFW_KEY_SPACE) == GLFW_PRESS && chunk_collision(player.camera.pos + glm::vec3(0, 2, 0)) && player.velocity.y == 0) {
+    if (glfwGetKey(engine.window, GLFW_KEY_SPACE) == GLFW_PRESS && !player.ghost_mode && !player.is_jumping) {
         player.velocity += player.camera.up * 0.5f;
         player.is_jumping = true;
     }
-    
+
     if (!player.ghost_mode) {
-        if (chunk_collision(player.camera.pos +  glm::vec3(0, 2, 0)) && player.velocity.y > 0) {
-            player.velocity.y = 0;
-            player.is_jumping = false;
-        }
-        if (!chunk_collision(player.camera.pos + glm::vec3(0, 1.8, 0))) {
-            player.velocity.y += 0.02f;
-            player.velocity.y *= 1.5f;
-            player.is_jumping = true;
-        }
-        if (chunk_collision(player.camera.pos + glm::vec3(0, -0.2, 0)) && player.velocity.y < 0) {
-            player.velocity.y = 0;
-        }
-        if (chunk_collision(player.camera.pos + glm::vec3(player.velocity.x, player.velocity.y + 1, 0)) || chunk_collision(player.camera.pos + glm::vec3(player.velocity.x, player.velocity.y, 0))) {
-            player.velocity.x = 0;
-        }
-        if (chunk_collision(player.camera.pos + glm::vec3(0, player.velocity.y + 1, player.velocity.z)) || chunk_collision(player.camera.pos + glm::vec3(0, player.velocity.y, player.velocity.z))) {
-            player.velocity.z = 0;
+        player.velocity.y += 0.02f;
+        player.velocity.y *= 1.5f;
+        Aabb box = player.get_box();
+        glm::bvec3 blocked;
+        collider.forget_chunk();
+        player.camera.pos += collider.move(box, player.velocity, blocked);
+        // Only landing ends a jump, hitting a ceiling does not
+        player.is_jumping = !(blocked.y && player.velocity.y > 0);
+        for (int axis = 0; axis < 3; axis++) {
+            if (blocked[axis]) {
+                player.velocity[axis] = 0;
+            }
         }
     } else {
         if (glfwGetKey(engine.window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
@@ -511,38 +917,48 @@ void Bassicraft::move_player()
             player.velocity.y -= 0.02f;
         }
         player.velocity *= 1.3f;
+        player.camera.pos += player.velocity;
     }
-    player.camera.pos += player.velocity;
     player.velocity *= 0.6f;
 
     //player.camera.pos = glm::vec3(player.camera.pos.x - offset, player.camera.pos.y, player.camera.pos.z - offset);
 }
 
-bool Bassicraft::chunk_collision(glm::vec3 pos)
+void Bassicraft::tick()
 {
-    glm::vec2 chunk_pos = glm::vec2((int)pos.x / 16, (int)pos.z / 16);
-    glm::ivec3 block_pos = glm::ivec3(regular_modulo(floor(pos.x), 16), floor(pos.y), regular_modulo(floor(pos.z), 16));
+    previous_camera_pos = player.camera.pos;
+    if (is_cursor_locked) {
+        move_player();
+    }
+    run_block_updates();
+    entities.update(world, &pipeline.pool);
+    engine.tick_particles();
+    ticks++;
+}
 
-    if (pos.x < 0) {
-        chunk_pos.x--;
-    }
-    if (pos.z < 0) {
-        chunk_pos.y--;
-    }
-    for (auto& chunk : world) {
-        if (chunk.pos == chunk_pos) {
-            if (chunk.blocks[block_pos.x][block_pos.y][block_pos.z].type != 0) {
-                return true;
-            } else {
-                return false;
-            }
-        }
+void Bassicraft::simulate(int count)
+{
+    // Runs ticks without drawing, the particles catch up in the next frame
+    for (int i = 0; i < count; i++) {
+        tick();
     }
-    return true;
+    unload_load_new_chunks();
+}
+
+void Bassicraft::draw_interpolated()
+{
+    glm::vec3 pos = player.camera.pos;
+    float alpha = (float)(tick_accumulator / TICK_SECONDS);
+    player.camera.pos = glm::mix(previous_camera_pos, pos, alpha);
+    engine.particle_alpha = alpha;
+    engine.draw_frame(player, world);
+    player.camera.pos = pos;
 }
 
 Bassicraft::~Bassicraft()
 {
+    // Pipeline tasks light and mesh through members destroyed before it
+    pipeline.pool.stop();
     engine.wait_idle();
 
     engine.RemoveTexture(&selected_slot_tex);
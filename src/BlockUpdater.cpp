@@ -0,0 +1,228 @@
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+#include "BlockUpdater.hpp"
+
+// y points down
+static const glm::ivec3 DOWN = {0, 1, 0};
+static const glm::ivec3 SIDES[4] = {
+    {-1, 0, 0},
+    {1, 0, 0},
+    {0, 0, -1},
+    {0, 0, 1}
+};
+
+uint64_t BlockUpdater::get_section_key(glm::ivec3 section)
+{
+    return ((uint64_t)(section.x & 0x1fffff) << 42) | ((uint64_t)(section.y & 0x1fffff) << 21) | (uint64_t)(section.z & 0x1fffff);
+}
+
+Chunk* BlockUpdater::resolve(glm::ivec3 pos, glm::ivec3& local) const
+{
+    if (pos.y < 0 || pos.y >= 100) {
+        return nullptr;
+    }
+    local = glm::ivec3(pos.x & 15, pos.y, pos.z & 15);
+    return chunks.find(glm::ivec2(pos.x >> 4, pos.z >> 4));
+}
+
+uint16_t BlockUpdater::get_type(glm::ivec3 pos) const
+{
+    glm::ivec3 local;
+    Chunk* chunk = resolve(pos, local);
+    return chunk ? chunk->blocks[local.x][local.y][local.z].type : UNLOADED;
+}
+
+uint8_t BlockUpdater::get_level(glm::ivec3 pos) const
+{
+    glm::ivec3 local;
+    Chunk* chunk = resolve(pos, local);
+    if (!chunk) {
+        return 0;
+    }
+    auto found = chunk->fluid_levels.find((local.x * 100 + local.y) * 16 + local.z);
+    return found == chunk->fluid_levels.end() ? SOURCE_LEVEL : found->second;
+}
+
+size_t BlockUpdater::get_pending() const
+{
+    size_t pending = 0;
+    for (auto& [key, updates] : sections) {
+        pending += updates.size();
+    }
+    return pending;
+}
+
+void BlockUpdater::schedule(glm::ivec3 pos, int delay)
+{
+    uint64_t key = get_section_key(glm::ivec3(pos.x >> 4, pos.y >> 4, pos.z >> 4));
+    auto found = sections.find(key);
+    if (found == sections.end()) {
+        found = sections.emplace(key, std::vector<BlockUpdate>()).first;
+        active.push_back(key);
+    }
+    found->second.push_back({pos, tick + delay});
+}
+
+void BlockUpdater::schedule_around(glm::ivec3 pos)
+{
+    static const glm::ivec3 OFFSETS[7] = {
+        {0, 0, 0},
+        {0, -1, 0},
+        {0, 1, 0},
+        {-1, 0, 0},
+        {1, 0, 0},
+        {0, 0, -1},
+        {0, 0, 1}
+    };
+    for (auto& offset : OFFSETS) {
+        uint16_t type = get_type(pos + offset);
+        if (type != UNLOADED && behaviour[type] != BEHAVIOUR_STATIC) {
+            schedule(pos + offset, delays[behaviour[type]]);
+        }
+    }
+}
+
+void BlockUpdater::run_update(glm::ivec3 pos, std::vector<BlockChange>& changes) const
+{
+    uint16_t type = get_type(pos);
+    if (type == UNLOADED) {
+        return;
+    }
+    uint16_t below = get_type(pos + DOWN);
+    // The bottom of the world holds like a solid block
+    bool below_open = below == 0 || (below != UNLOADED && behaviour[below] == BEHAVIOUR_FLUID);
+
+    if (behaviour[type] == BEHAVIOUR_FALLING) {
+        if (below_open) {
+            changes.push_back({pos + DOWN, below, type, 0, false});
+            changes.push_back({pos, type, 0, 0, true});
+        }
+        return;
+    }
+    if (behaviour[type] != BEHAVIOUR_FLUID) {
+        return;
+    }
+
+    uint8_t level = get_level(pos);
+    if (level != SOURCE_LEVEL) {
+        // Flowing fluid takes its level from what feeds it
+        uint8_t fed = get_type(pos - DOWN) == type ? FALLING_LEVEL : 0;
+        for (auto& side : SIDES) {
+            if (get_type(pos + side) == type) {
+                fed = std::max(fed, (uint8_t)(get_level(pos + side) - 1));
+            }
+        }
+        if (fed == 0) {
+            changes.push_back({pos, type, 0, 0, false});
+            return;
+        }
+        if (fed != level) {
+            changes.push_back({pos, type, type, fed, false});
+            level = fed;
+        }
+    }
+
+    if (below == 0) {
+        changes.push_back({pos + DOWN, 0, type, FALLING_LEVEL, false});
+        return;
+    }
+    // Fluid on fluid does not spread sideways, neither does the last level
+    if (below_open || level <= 1) {
+        return;
+    }
+    for (auto& side : SIDES) {
+        if (get_type(pos + side) == 0) {
+            changes.push_back({pos + side, 0, type, (uint8_t)(level - 1), false});
+        }
+    }
+}
+
+void BlockUpdater::update(ThreadPool* pool, std::vector<BlockChange>& applied)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    tick++;
+    last_updates = 0;
+    last_changes = 0;
+
+    // Due updates of each section, visited from where the last tick stopped
+    std::vector<std::vector<glm::ivec3>> work;
+    for (size_t remaining = active.size(); remaining > 0 && last_updates < max_updates_per_tick; remaining--) {
+        uint64_t key = active.front();
+        active.pop_front();
+        std::vector<BlockUpdate>& pending = sections[key];
+        std::vector<glm::ivec3> due;
+        size_t kept = 0;
+        for (auto& update : pending) {
+            if (update.due <= tick && last_updates + due.size() < max_updates_per_tick) {
+                due.push_back(update.pos);
+            } else {
+                pending[kept++] = update;
+            }
+        }
+        pending.resize(kept);
+        if (pending.empty()) {
+            sections.erase(key);
+        } else {
+            active.push_back(key);
+        }
+
+        // A block is often scheduled by several of its neighbours
+        std::sort(due.begin(), due.end(), [](glm::ivec3 a, glm::ivec3 b) {
+            return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+        });
+        due.erase(std::unique(due.begin(), due.end()), due.end());
+        last_updates += due.size();
+        if (!due.empty()) {
+            work.push_back(std::move(due));
+        }
+    }
+
+    std::vector<std::vector<BlockChange>> changes(work.size());
+    auto batch = [&](size_t b) {
+        for (glm::ivec3 pos : work[b]) {
+            run_update(pos, changes[b]);
+        }
+    };
+    if (pool) {
+        pool->run_batches(work.size(), batch, std::numeric_limits<int>::min());
+    } else {
+        for (size_t b = 0; b < work.size(); b++) {
+            batch(b);
+        }
+    }
+
+    for (auto& section : changes) {
+        bool previous = false;
+        for (auto& change : section) {
+            glm::ivec3 local;
+            Chunk* chunk = resolve(change.pos, local);
+            Cube* cube = chunk ? &chunk->blocks[local.x][local.y][local.z] : nullptr;
+            bool expected = cube && cube->type == change.expected && (previous || !change.needs_previous);
+            if (!expected || (cube->type == change.type && get_level(change.pos) == change.level)) {
+                previous = false;
+                continue;
+            }
+            previous = true;
+            last_changes++;
+
+            // Levels are saved with the chunk like the edits
+            chunk->modified = true;
+            uint16_t index = (local.x * 100 + local.y) * 16 + local.z;
+            if (behaviour[change.type] == BEHAVIOUR_FLUID && change.level != SOURCE_LEVEL) {
+                chunk->fluid_levels[index] = change.level;
+            } else {
+                chunk->fluid_levels.erase(index);
+            }
+            if (cube->type != change.type) {
+                cube->type = change.type;
+                chunk->record_edit(local, change.type);
+                applied.push_back(change);
+            }
+            schedule_around(change.pos);
+        }
+    }
+
+    last_ms = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
@@ -1,23 +1,42 @@
 #include <iostream>
 #include <cstring>
 #include <stdexcept>
+#include <chrono>
 
-#include "VkEngine.hpp"
 #include "Chunk.hpp"
 
-Chunk::Chunk(glm::vec2 pos, FastNoiseLite& noise, FastNoiseLite& biome_noise) : pos(pos)
+std::array<bool, 257> Chunk::see_through = {true};
+
+Chunk::Chunk(glm::vec2 pos) : pos(pos)
+{
+    for (auto& side : border_light) {
+        side.fill(0xf0);
+    }
+}
+
+Chunk::Chunk(glm::vec2 pos, WorldGenerator& generator) : Chunk(pos)
 {
-    int biome = (int)abs(biome_noise.GetNoise(pos.x, pos.y) * 10);
+    auto start = std::chrono::high_resolution_clock::now();
+    ChunkColumns columns = generator.get_columns(glm::ivec2(pos));
+    int biome = columns.biome;
 
     uint16_t block_surface = (biome == 0) ? 19 : (biome == 9) ? 67 : 1;
     uint16_t block_under_surface = (biome == 0) ? 19 : (biome == 9) ? 67 : 3;
     uint16_t water_type = (biome == 0) ?  : (biome == 9) ? 68 : 206;
 
+    const std::array<int, 256>& heights = columns.heights;
+
+    if (generator.terrain_mode == WorldGenerator::TERRAIN_DENSITY) {
+        fill_density(generator, heights, block_surface, block_under_surface, water_type);
+        generator.record_generation_time(WorldGenerator::TERRAIN_DENSITY, std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count());
+        return;
+    }
+
     for (int x = 0; x < 16; x++)
     {
         for (int z = 0; z < 16; z++)
         {
-            int height = (int)(noise.GetNoise((float)(x + pos.x * 16), (float)(z + pos.y * 16)) * 10) + 10;
+            int height = heights[x * 16 + z];
             //DEBUG for super flat world
             //height = 15;
             for (int y = 20; y > height - 1; y--)
@@ -34,40 +53,222 @@ Chunk::Chunk(glm::vec2 pos, FastNoiseLite& noise, FastNoiseLite& biome_noise) :
             {
                 blocks[x][y][z] = {glm::ivec3(x, y, z), water_type, 0};
             }
-            // if (rand() % 100 == 5 && height <= 16) {
-            //     put_tree(glm::ivec3(x, height, z));
-            // }
         }
     }
+    generator.record_generation_time(WorldGenerator::TERRAIN_HEIGHTFIELD, std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count());
 }
 
-void Chunk::put_tree(glm::ivec3 pos)
+void Chunk::fill_density(WorldGenerator& generator, const std::array<int, 256>& heights, uint16_t block_surface, uint16_t block_under_surface, uint16_t water_type)
 {
-    if (pos.y < 5 || pos.y > 95 || pos.x < 2 || pos.x > 13 || pos.z < 2 || pos.z > 13) {
-        return;
+    const int depth = WorldGenerator::DENSITY_DEPTH;
+    std::array<bool, 16 * depth * 16> solid;
+    generator.get_solid_blocks(pos, heights, solid);
+
+    for (int x = 0; x < 16; x++) {
+        for (int z = 0; z < 16; z++) {
+            // Water only fills the air that is open to the sky
+            bool open_sky = true;
+            for (int y = 0; y < depth; y++) {
+                if (solid[(x * depth + y) * 16 + z]) {
+                    bool is_top = y == 0 || !solid[(x * depth + y - 1) * 16 + z];
+                    blocks[x][y][z] = {glm::ivec3(x, y, z), is_top ? block_surface : block_under_surface, 0};
+                    open_sky = false;
+                } else if (open_sky && y > 15) {
+                    blocks[x][y][z] = {glm::ivec3(x, y, z), water_type, 0};
+                }
+            }
+        }
+    }
+}
+
+void Chunk::put_tree(glm::ivec3 pos, std::vector<DecorationBlock>& decoration)
+{
+    // pos is the ground block under the trunk, the trunk goes first so the
+    // leaves around it don't take its place
+    for (int y = pos.y - 4; y < pos.y; y++) {
+        decoration.push_back({glm::ivec3(pos.x, y, pos.z), 21});
     }
     for (int y = pos.y - 4; y < pos.y - 2; y++) {
         for (int x = pos.x - 2; x < pos.x + 3; x++) {
             for (int z = pos.z - 2; z < pos.z + 3; z++) {
-                blocks[x][y][z] = {glm::ivec3(x, y, z), 54};
+                decoration.push_back({glm::ivec3(x, y, z), 54});
             }
         }
     }
     for (int x = pos.x - 1; x < pos.x + 2; x++) {
         for (int z = pos.z - 1; z < pos.z + 2; z++) {
-            blocks[x][pos.y - 5][z] = {glm::ivec3(x, pos.y - 5, z), 54};
+            decoration.push_back({glm::ivec3(x, pos.y - 5, z), 54});
         }
     }
-    for (int y = pos.y - 4; y < pos.y; y++) {
-        blocks[pos.x][y][pos.z] = {glm::ivec3(pos.x, y, pos.z), 21};
+    decoration.push_back({glm::ivec3(pos.x, pos.y - 6, pos.z), 54});
+    decoration.push_back({glm::ivec3(pos.x - 1, pos.y - 6, pos.z), 54});
+    decoration.push_back({glm::ivec3(pos.x + 1, pos.y - 6, pos.z), 54});
+    decoration.push_back({glm::ivec3(pos.x, pos.y - 6, pos.z - 1), 54});
+    decoration.push_back({glm::ivec3(pos.x, pos.y - 6, pos.z + 1), 54});
+}
+
+void Chunk::decorate(WorldGenerator& generator, std::vector<DecorationBlock>& decoration)
+{
+    // Only reads this chunk, what lands in the neighbours is applied by them
+    ChunkRandom random = generator.get_chunk_random(glm::ivec2(pos), TREE_STREAM);
+    for (int x = 0; x < 16; x++) {
+        for (int z = 0; z < 16; z++) {
+            if (random.at(x * 16 + z) % 100 != 5) {
+                continue;
+            }
+            int y = 0;
+            while (y < 100 && blocks[x][y][z].type == 0) {
+                y++;
+            }
+            // Grass above the water level with room for the leaves
+            if (y < 7 || y > 15 || blocks[x][y][z].type != 1) {
+                continue;
+            }
+            put_tree(glm::ivec3(pos.x * 16 + x, y, pos.y * 16 + z), decoration);
+        }
+    }
+}
+
+void Chunk::apply_decoration(const std::vector<DecorationBlock>& decoration)
+{
+    glm::ivec3 origin(pos.x * 16, 0, pos.y * 16);
+    for (auto& block : decoration) {
+        glm::ivec3 local = block.pos - origin;
+        if (local.x < 0 || local.x > 15 || local.y < 0 || local.y > 99 || local.z < 0 || local.z > 15) {
+            continue;
+        }
+        if (blocks[local.x][local.y][local.z].type == 0) {
+            blocks[local.x][local.y][local.z] = {local, block.type, 0};
+        }
+    }
+}
+
+void Chunk::record_edit(glm::ivec3 pos, uint16_t type)
+{
+    edits[(pos.x * 100 + pos.y) * 16 + pos.z] = type;
+    modified = true;
+}
+
+void Chunk::apply_edits()
+{
+    for (auto& [index, type] : edits) {
+        int x = index / (100 * 16);
+        int y = index / 16 % 100;
+        int z = index % 16;
+        blocks[x][y][z] = {glm::ivec3(x, y, z), type, 0};
+    }
+}
+
+void Chunk::set_types(const std::vector<uint16_t>& types)
+{
+    for (int x = 0; x < 16; x++) {
+        for (int y = 0; y < 100; y++) {
+            for (int z = 0; z < 16; z++) {
+                uint16_t type = types[(x * 100 + y) * 16 + z];
+                // New chunks are already air, like generated ones
+                if (type != 0) {
+                    blocks[x][y][z] = {glm::ivec3(x, y, z), type, 0};
+                }
+            }
+        }
+    }
+}
+
+uint16_t Chunk::get_lod_block(int x, int y, int z, int scale)
+{
+    // Majority vote over the scale^3 cell starting at (x, y, z), the cell is
+    // solid if at least half of its blocks are, using the most common type
+    std::array<int, 257> counts{};
+    int solid = 0;
+    int total = 0;
+    uint16_t best = 0;
+
+    for (int i = x; i < x + scale && i < 16; i++) {
+        for (int j = y; j < y + scale && j < 100; j++) {
+            for (int k = z; k < z + scale && k < 16; k++) {
+                uint16_t type = blocks[i][j][k].type;
+                total++;
+                if (type == 0 || type > 256) {
+                    continue;
+                }
+                solid++;
+                counts[type]++;
+                if (counts[type] > counts[best]) {
+                    best = type;
+                }
+            }
+        }
+    }
+    if (solid * 2 < total) {
+        return 0;
     }
-    blocks[pos.x][pos.y - 6][pos.z] = {glm::ivec3(pos.x, pos.y - 6, pos.z), 54};
-    blocks[pos.x - 1][pos.y - 6][pos.z] = {glm::ivec3(pos.x - 1, pos.y - 6, pos.z), 54};
-    blocks[pos.x + 1][pos.y - 6][pos.z] = {glm::ivec3(pos.x + 1, pos.y - 6, pos.z), 54};
-    blocks[pos.x][pos.y - 6][pos.z - 1] = {glm::ivec3(pos.x, pos.y - 6, pos.z - 1), 54};
-    blocks[pos.x][pos.y - 6][pos.z + 1] = {glm::ivec3(pos.x, pos.y - 6, pos.z + 1), 54};
+    return best;
 }
 
-Chunk::~Chunk()
+uint8_t Chunk::get_face_light(int x, int y, int z) const
 {
+    // Above the world is open sky
+    if (y < 0) {
+        return 0xf0;
+    }
+    if (y >= 100) {
+        return 0;
+    }
+    if (x < 0 || x >= 16) {
+        return border_light[x < 0 ? 0 : 1][y * 16 + z];
+    }
+    if (z < 0 || z >= 16) {
+        return border_light[z < 0 ? 2 : 3][y * 16 + x];
+    }
+    return light[(x * 100 + y) * 16 + z];
+}
+
+void Chunk::compute_heightmap()
+{
+    opaque_counts.fill(0);
+    for (int x = 0; x < 16; x++) {
+        for (int z = 0; z < 16; z++) {
+            heightmap[x * 16 + z] = 100;
+            for (int y = 99; y >= 0; y--) {
+                if (!see_through[blocks[x][y][z].type]) {
+                    heightmap[x * 16 + z] = y;
+                    opaque_counts[y]++;
+                }
+            }
+        }
+    }
+}
+
+void Chunk::update_heightmap(glm::ivec3 pos, uint16_t old_type)
+{
+    bool was_opaque = !see_through[old_type];
+    bool opaque = !see_through[blocks[pos.x][pos.y][pos.z].type];
+    if (was_opaque == opaque) {
+        return;
+    }
+    opaque_counts[pos.y] += opaque ? 1 : -1;
+    uint8_t& height = heightmap[pos.x * 16 + pos.z];
+    if (opaque && pos.y < height) {
+        height = pos.y;
+    } else if (!opaque && pos.y == height) {
+        int y = pos.y;
+        while (y < 100 && see_through[blocks[pos.x][y][pos.z].type]) {
+            y++;
+        }
+        height = y;
+    }
+}
+
+int Chunk::get_surface(int x, int z) const
+{
+    return heightmap[x * 16 + z];
+}
+
+bool Chunk::is_layer_buried(int y) const
+{
+    // The top layer is under open sky and the bottom one is seen from below
+    if (y <= 0 || y >= 99) {
+        return false;
+    }
+    return opaque_counts[y - 1] == 256 && opaque_counts[y] == 256 && opaque_counts[y + 1] == 256;
 }
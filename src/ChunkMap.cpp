@@ -0,0 +1,18 @@
+#include "ChunkMap.hpp"
+#include "Chunk.hpp"
+
+void ChunkMap::set_world(std::vector<Chunk>& world)
+{
+    chunks.clear();
+    for (auto& chunk : world) {
+        if (!chunk.should_be_deleted) {
+            chunks[get_chunk_key(glm::ivec2(chunk.pos))] = &chunk;
+        }
+    }
+}
+
+Chunk* ChunkMap::find(glm::ivec2 pos) const
+{
+    auto found = chunks.find(get_chunk_key(pos));
+    return found == chunks.end() ? nullptr : found->second;
+}
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <utility>
+
+#include "ChunkPipeline.hpp"
+
+ChunkPipeline::ChunkPipeline(WorldGenerator& generator, ChunkStorage& storage) : generator(generator), storage(storage)
+{
+}
+
+ChunkPipeline::~ChunkPipeline()
+{
+    // Loads still opening a region or reading call back into the pipeline
+    storage.flush();
+}
+
+bool ChunkPipeline::neighbours_decorated(glm::ivec2 pos)
+{
+    for (int x = -1; x <= 1; x++) {
+        for (int z = -1; z <= 1; z++) {
+            auto found = entries.find(get_chunk_key(pos + glm::ivec2(x, z)));
+            if (found == entries.end() || found->second.stage < STAGE_DECORATED) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void ChunkPipeline::finish_stage(glm::ivec2 pos, Stage stage)
+{
+    Entry& entry = entries[get_chunk_key(pos)];
+    entry.stage = stage;
+    entry.busy = false;
+}
+
+void ChunkPipeline::load_terrain(glm::ivec2 pos, const ChunkRecord& record)
+{
+    auto saved = storage.decode(pos, record);
+    if (saved && !saved->types.empty()) {
+        auto chunk = std::make_unique<Chunk>(glm::vec2(pos));
+        chunk->set_types(saved->types);
+        chunk->edits = saved->edits;
+        chunk->fluid_levels = saved->fluid_levels;
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& entry = entries[get_chunk_key(pos)];
+        entry.chunk = std::move(chunk);
+        entry.from_disk = true;
+        decorations[get_chunk_key(pos)] = saved->decoration;
+        finish_stage(pos, STAGE_DECORATED);
+        return;
+    }
+    // Edits alone are replayed once the trees are in
+    auto chunk = std::make_unique<Chunk>(glm::vec2(pos), generator);
+    if (saved) {
+        chunk->edits = saved->edits;
+        chunk->fluid_levels = saved->fluid_levels;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = entries[get_chunk_key(pos)];
+    entry.chunk = std::move(chunk);
+    entry.from_disk = false;
+    finish_stage(pos, STAGE_TERRAIN);
+}
+
+void ChunkPipeline::start_stage(Entry& entry, int distance, int priority)
+{
+    glm::ivec2 pos = entry.pos;
+    Chunk* chunk = entry.chunk.get();
+    entry.busy = true;
+
+    switch (entry.stage) {
+    case STAGE_QUEUED:
+        // Nearest chunks are read first, the record is decoded on a worker
+        storage.load_async(pos, priority, [this, pos, priority](ChunkRecord record) {
+            pool.submit([this, pos, record = std::move(record)] {
+                load_terrain(pos, record);
+            }, priority);
+        });
+        break;
+    case STAGE_TERRAIN:
+        pool.submit([this, pos, chunk] {
+            std::vector<DecorationBlock> decoration;
+            chunk->decorate(generator, decoration);
+            std::lock_guard<std::mutex> lock(mutex);
+            decorations[get_chunk_key(pos)] = std::move(decoration);
+            finish_stage(pos, STAGE_DECORATED);
+        }, priority);
+        break;
+    case STAGE_DECORATED: {
+        // The neighbours are all decorated, nothing else will write here.
+        // Chunks saved with their blocks got their trees before being edited.
+        std::vector<DecorationBlock> decoration;
+        for (int x = -1; x <= 1 && !entry.from_disk; x++) {
+            for (int z = -1; z <= 1; z++) {
+                auto& blocks = decorations[get_chunk_key(pos + glm::ivec2(x, z))];
+                decoration.insert(decoration.end(), blocks.begin(), blocks.end());
+            }
+        }
+        pool.submit([this, pos, chunk, decoration] {
+            chunk->apply_decoration(decoration);
+            chunk->apply_edits();
+            chunk->compute_heightmap();
+            light(*chunk);
+            std::lock_guard<std::mutex> lock(mutex);
+            finish_stage(pos, STAGE_LIT);
+        }, priority);
+        break;
+    }
+    case STAGE_LIT:
+        chunk->lod = get_lod(distance);
+        pool.submit([this, pos, chunk] {
+            mesh(*chunk);
+            std::lock_guard<std::mutex> lock(mutex);
+            finish_stage(pos, STAGE_MESHED);
+        }, priority);
+        break;
+    default:
+        entry.busy = false;
+        break;
+    }
+}
+
+void ChunkPipeline::save_chunk(const Chunk& chunk)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    storage.save(chunk, decorations[get_chunk_key(glm::ivec2(chunk.pos))]);
+}
+
+bool ChunkPipeline::in_area(glm::ivec2 pos, int inner)
+{
+    int d = render_distance;
+    for (glm::ivec2 center : centers) {
+        glm::ivec2 offset = pos - center;
+        if (offset.x >= -d - inner && offset.x <= d && offset.y >= -d - inner && offset.y <= d) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ChunkPipeline::in_meshed_area(glm::ivec2 pos)
+{
+    int d = render_distance;
+    for (glm::ivec2 center : centers) {
+        glm::ivec2 offset = pos - center;
+        if (offset.x >= -d && offset.x < d && offset.y >= -d && offset.y < d) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ChunkPipeline::Stage ChunkPipeline::get_stage(glm::ivec2 pos)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(get_chunk_key(pos));
+    return found == entries.end() ? STAGE_QUEUED : found->second.stage;
+}
+
+size_t ChunkPipeline::update(std::vector<Chunk>& world)
+{
+    auto update_start = std::chrono::high_resolution_clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    int d = render_distance;
+    size_t added = 0;
+    spent_ms.fill(0.0f);
+
+    for (auto it = entries.begin(); it != entries.end();) {
+        Entry& entry = it->second;
+        if (entry.busy) {
+            it++;
+        } else if (!in_area(entry.pos, 1)) {
+            decorations.erase(it->first);
+            it = entries.erase(it);
+        } else {
+            // The world unloads chunks out of the area, they are regenerated
+            // if they come back
+            if (entry.stage == STAGE_LOADED && !in_area(entry.pos, 0)) {
+                entry.stage = STAGE_QUEUED;
+            }
+            it++;
+        }
+    }
+
+    // Closest chunks first, the ones in the view direction before the ones
+    // behind, which are pushed up to view_weight chunks further
+    glm::ivec2 center = centers[0];
+    // Room for every chunk of both areas, so adding one never moves the
+    // others
+    world.reserve(centers.size() * (2 * d + 1) * (2 * d + 1));
+    glm::ivec2 low = glm::min(centers[0], centers[1]) - glm::ivec2(d + 1);
+    glm::ivec2 high = glm::max(centers[0], centers[1]) + glm::ivec2(d);
+    std::vector<std::pair<float, glm::ivec2>> order;
+    for (int x = low.x; x <= high.x; x++) {
+        for (int z = low.y; z <= high.y; z++) {
+            glm::ivec2 pos(x, z);
+            if (!in_area(pos, 1)) {
+                continue;
+            }
+            glm::vec2 offset = glm::vec2(pos - center);
+            float distance = std::max(fabsf(offset.x), fabsf(offset.y));
+            float alignment = distance > 0 ? glm::dot(offset / glm::length(offset), view_direction) : 1.0f;
+            order.push_back({distance + (1.0f - alignment) * 0.5f * view_weight, pos});
+        }
+    }
+    std::sort(order.begin(), order.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+    // Each stage stops starting work for this frame once its budget is
+    // spent, the rest waits for the next frames in the same order
+    for (auto& [score, pos] : order) {
+        bool meshed = in_meshed_area(pos);
+        Entry& entry = entries[get_chunk_key(pos)];
+        entry.pos = pos;
+        Stage stage = entry.stage;
+        if (entry.busy || stage == STAGE_LOADED || (!meshed && stage >= STAGE_DECORATED) || spent_ms[stage] >= budget_ms[stage]) {
+            continue;
+        }
+        if (stage == STAGE_DECORATED && !neighbours_decorated(pos)) {
+            continue;
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        if (stage == STAGE_MESHED) {
+            world.push_back(std::move(*entry.chunk));
+            upload(world.back());
+            entry.chunk.reset();
+            entry.stage = STAGE_LOADED;
+            added++;
+        } else {
+            // Scores are fractions of a chunk, the pool and the reads take
+            // integer priorities
+            glm::ivec2 offset = pos - center;
+            start_stage(entry, std::max(abs(offset.x), abs(offset.y)), (int)(score * 16));
+        }
+        spent_ms[stage] += std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    stage_counts.fill(0);
+    for (auto& [key, entry] : entries) {
+        stage_counts[entry.stage]++;
+    }
+    update_ms = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - update_start).count();
+    worst_update_ms = std::max(worst_update_ms, update_ms);
+    return added;
+}
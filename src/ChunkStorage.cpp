@@ -0,0 +1,321 @@
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+
+#include "ChunkStorage.hpp"
+#include "Lz4.hpp"
+
+static const size_t BLOCK_COUNT = 16 * 100 * 16;
+
+ChunkStorage::ChunkStorage()
+{
+}
+
+ChunkStorage::~ChunkStorage()
+{
+    flush();
+}
+
+void ChunkStorage::flush()
+{
+    pool.wait();
+    io.wait();
+}
+
+void ChunkStorage::open(const std::string& directory)
+{
+    flush();
+    std::lock_guard<std::mutex> lock(mutex);
+    std::filesystem::create_directories(directory);
+    this->directory = directory;
+    regions.clear();
+    missing_regions.clear();
+}
+
+RegionFile* ChunkStorage::get_region_file(glm::ivec2 chunk_pos, bool create)
+{
+    glm::ivec2 region = RegionFile::get_region(chunk_pos);
+    uint64_t key = get_chunk_key(region);
+    auto found = regions.find(key);
+    if (found != regions.end()) {
+        return found->second.get();
+    }
+    if (!create && missing_regions.count(key)) {
+        return nullptr;
+    }
+    std::string path = directory + "/r." + std::to_string(region.x) + "." + std::to_string(region.y) + ".bcr";
+    if (!create && !std::filesystem::exists(path)) {
+        missing_regions.insert(key);
+        return nullptr;
+    }
+    missing_regions.erase(key);
+    auto& file = regions[key];
+    file = std::make_unique<RegionFile>(path);
+    return file.get();
+}
+
+void ChunkStorage::serialize(const SavedChunk& saved, std::vector<uint8_t>& data)
+{
+    // Whether block types follow and the types, the decoration count and
+    // blocks, the edit count and edits, then the fluid level count and
+    // levels, LZ4 compressed behind the uncompressed size
+    std::vector<uint8_t> raw;
+    auto put = [&raw](const void* value, size_t size) {
+        raw.insert(raw.end(), (const uint8_t*)value, (const uint8_t*)value + size);
+    };
+    uint8_t has_blocks = !saved.types.empty();
+    put(&has_blocks, 1);
+    if (has_blocks) {
+        put(saved.types.data(), BLOCK_COUNT * 2);
+    }
+    uint32_t count = saved.decoration.size();
+    put(&count, 4);
+    for (auto& block : saved.decoration) {
+        int32_t pos[3] = {block.pos.x, block.pos.y, block.pos.z};
+        put(pos, 12);
+        put(&block.type, 2);
+    }
+    count = saved.edits.size();
+    put(&count, 4);
+    for (auto& [index, type] : saved.edits) {
+        put(&index, 2);
+        put(&type, 2);
+    }
+    count = saved.fluid_levels.size();
+    put(&count, 4);
+    for (auto& [index, level] : saved.fluid_levels) {
+        put(&index, 2);
+        put(&level, 1);
+    }
+
+    std::vector<uint8_t> compressed;
+    lz4_compress(raw.data(), raw.size(), compressed);
+    uint32_t size = raw.size();
+    data.resize(4 + compressed.size());
+    memcpy(data.data(), &size, 4);
+    memcpy(data.data() + 4, compressed.data(), compressed.size());
+}
+
+bool ChunkStorage::deserialize(const std::vector<uint8_t>& data, SavedChunk& saved)
+{
+    uint32_t size;
+    if (data.size() < 4) {
+        return false;
+    }
+    memcpy(&size, data.data(), 4);
+    // Blocks, decoration and edits can't take more than this
+    if (size > BLOCK_COUNT * 2 * 4) {
+        return false;
+    }
+    std::vector<uint8_t> raw(size);
+    if (!lz4_decompress(data.data() + 4, data.size() - 4, raw.data(), size)) {
+        return false;
+    }
+    size_t offset = 0;
+    auto get = [&raw, &offset](void* value, size_t size) {
+        if (raw.size() - offset < size) {
+            return false;
+        }
+        memcpy(value, raw.data() + offset, size);
+        offset += size;
+        return true;
+    };
+
+    uint8_t has_blocks;
+    if (!get(&has_blocks, 1)) {
+        return false;
+    }
+    if (has_blocks) {
+        saved.types.resize(BLOCK_COUNT);
+        if (!get(saved.types.data(), BLOCK_COUNT * 2)) {
+            return false;
+        }
+    }
+    uint32_t count;
+    if (!get(&count, 4) || count > (raw.size() - offset) / 14) {
+        return false;
+    }
+    saved.decoration.resize(count);
+    for (auto& block : saved.decoration) {
+        int32_t pos[3];
+        get(pos, 12);
+        get(&block.type, 2);
+        block.pos = glm::ivec3(pos[0], pos[1], pos[2]);
+    }
+    if (!get(&count, 4) || count > (raw.size() - offset) / 4) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t index;
+        uint16_t type;
+        get(&index, 2);
+        get(&type, 2);
+        if (index >= BLOCK_COUNT) {
+            return false;
+        }
+        saved.edits[index] = type;
+    }
+    // Saves from before fluid levels end with the edits
+    if (offset == raw.size()) {
+        return true;
+    }
+    if (!get(&count, 4) || count != (raw.size() - offset) / 3) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t index;
+        uint8_t level;
+        get(&index, 2);
+        get(&level, 1);
+        if (index >= BLOCK_COUNT) {
+            return false;
+        }
+        saved.fluid_levels[index] = level;
+    }
+    return true;
+}
+
+void ChunkStorage::load_async(glm::ivec2 chunk_pos, int priority, std::function<void(ChunkRecord record)> done)
+{
+    uint64_t key = get_chunk_key(chunk_pos);
+    uint64_t region_key = get_chunk_key(RegionFile::get_region(chunk_pos));
+    ChunkRecord record;
+    uint64_t offset;
+    size_t size;
+    RegionFile* region = nullptr;
+    bool known;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto pending = pending_saves.find(key);
+        if (pending != pending_saves.end()) {
+            record.saved = pending->second;
+        }
+        auto found = regions.find(region_key);
+        if (found != regions.end()) {
+            region = found->second.get();
+        }
+        known = region || missing_regions.count(region_key);
+    }
+    if (!record.saved && !known) {
+        // Looking for the file and reading its table stays off the main
+        // thread, the load starts again once the region is known
+        pool.submit([this, chunk_pos, priority, region_key, done] {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                try {
+                    get_region_file(chunk_pos, false);
+                } catch (const std::exception& e) {
+                    std::cerr << e.what() << std::endl;
+                    missing_regions.insert(region_key);
+                }
+            }
+            load_async(chunk_pos, priority, done);
+        }, priority);
+        return;
+    }
+    if (record.saved || !region || !region->locate(chunk_pos, offset, size)) {
+        done(std::move(record));
+        return;
+    }
+    io.read(region->fd, offset, size, priority, key, [done](bool ok, std::vector<uint8_t>& data) {
+        ChunkRecord record;
+        if (ok) {
+            record.data = std::move(data);
+        }
+        done(std::move(record));
+    });
+}
+
+std::shared_ptr<const SavedChunk> ChunkStorage::decode(glm::ivec2 chunk_pos, const ChunkRecord& record)
+{
+    if (record.saved || record.data.empty()) {
+        return record.saved;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<uint8_t> data;
+    uint8_t compression;
+    auto saved = std::make_shared<SavedChunk>();
+    if (!RegionFile::parse_record(record.data, data, compression) || compression != RegionFile::COMPRESSION_LZ4 || !deserialize(data, *saved)) {
+        std::cerr << "Corrupt chunk " << chunk_pos.x << " " << chunk_pos.y << " in " << directory << ", regenerating it" << std::endl;
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    loaded_chunks++;
+    float ms = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+    decode_ms += (ms - decode_ms) / loaded_chunks;
+    return saved;
+}
+
+void ChunkStorage::save(const Chunk& chunk, const std::vector<DecorationBlock>& decoration)
+{
+    glm::ivec2 chunk_pos(chunk.pos);
+    uint64_t key = get_chunk_key(chunk_pos);
+    auto saved = std::make_shared<SavedChunk>();
+    saved->edits = chunk.edits;
+    saved->fluid_levels = chunk.fluid_levels;
+    // Without blocks the chunk is generated again, decoration included
+    if (!save_edits_only) {
+        saved->types.resize(BLOCK_COUNT);
+        for (int x = 0; x < 16; x++) {
+            for (int y = 0; y < 100; y++) {
+                for (int z = 0; z < 16; z++) {
+                    saved->types[(x * 100 + y) * 16 + z] = chunk.blocks[x][y][z].type;
+                }
+            }
+        }
+        saved->decoration = decoration;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending_saves[key] = saved;
+    }
+
+    pool.submit([this, chunk_pos, key, saved] {
+        std::vector<uint8_t> data;
+        serialize(*saved, data);
+        std::lock_guard<std::mutex> lock(mutex);
+        RegionFile* region;
+        uint32_t entry;
+        try {
+            region = get_region_file(chunk_pos, true);
+            entry = region->allocate(chunk_pos, data.size());
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            pending_saves.erase(key);
+            return;
+        }
+        std::vector<uint8_t> record;
+        RegionFile::make_record(data, RegionFile::COMPRESSION_LZ4, entry & 0xff, record);
+        size_t size = data.size();
+
+        // The table entry is written once the record is on disk
+        io.write(region->fd, (uint64_t)(entry >> 8) * RegionFile::SECTOR_SIZE, std::move(record), SAVE_PRIORITY, [this, region, chunk_pos, key, saved, entry, size](bool ok, std::vector<uint8_t>&) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (region->record_written(chunk_pos, entry, ok)) {
+                // Table entries of a chunk are written in the order they
+                // were queued, its old sectors are freed once the new one is
+                // on disk
+                std::vector<uint8_t> table_entry(4);
+                memcpy(table_entry.data(), &entry, 4);
+                io.write(region->fd, RegionFile::get_index(chunk_pos) * 4, std::move(table_entry), SAVE_PRIORITY, [region, chunk_pos, entry](bool ok, std::vector<uint8_t>&) {
+                    if (ok) {
+                        region->entry_written(chunk_pos, entry);
+                    }
+                });
+            }
+            if (ok) {
+                saved_chunks++;
+                saved_bytes += size;
+            } else {
+                std::cerr << "Could not write chunk " << chunk_pos.x << " " << chunk_pos.y << " to " << region->path << std::endl;
+            }
+            // A newer save of the chunk may have been queued meanwhile
+            auto pending = pending_saves.find(key);
+            if (pending != pending_saves.end() && pending->second == saved) {
+                pending_saves.erase(pending);
+            }
+        });
+    });
+}
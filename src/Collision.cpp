@@ -0,0 +1,105 @@
+#include <cmath>
+#include <algorithm>
+
+#include "Collision.hpp"
+
+VoxelCollider::VoxelCollider(std::vector<Chunk>& world) : world(world)
+{
+}
+
+void VoxelCollider::forget_chunk()
+{
+    last_chunk = nullptr;
+    has_last = false;
+    chunks_built = false;
+}
+
+bool VoxelCollider::is_solid(glm::ivec3 cell)
+{
+    if (cell.y < 0) {
+        return false;
+    }
+    if (cell.y >= 100) {
+        return true;
+    }
+    glm::ivec2 chunk_pos(cell.x >> 4, cell.z >> 4);
+    if (!has_last || last_pos != chunk_pos) {
+        chunk_lookups++;
+        if (!chunks_built) {
+            chunks.set_world(world);
+            chunks_built = true;
+        }
+        last_chunk = chunks.find(chunk_pos);
+        last_pos = chunk_pos;
+        has_last = true;
+    }
+    if (!last_chunk) {
+        return true;
+    }
+    return last_chunk->blocks[cell.x & 15][cell.y][cell.z & 15].type != 0;
+}
+
+bool VoxelCollider::overlaps_block(const Aabb& box)
+{
+    for (int x = (int)floorf(box.min.x); x < (int)ceilf(box.max.x); x++) {
+        for (int y = (int)floorf(box.min.y); y < (int)ceilf(box.max.y); y++) {
+            for (int z = (int)floorf(box.min.z); z < (int)ceilf(box.max.z); z++) {
+                if (is_solid(glm::ivec3(x, y, z))) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+float VoxelCollider::sweep_axis(const Aabb& box, int axis, float delta)
+{
+    if (delta == 0.0f) {
+        return 0.0f;
+    }
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+    // Blocks the box overlaps on the two other axes, touching is not
+    // overlapping
+    int u_first = (int)floorf(box.min[u]);
+    int u_last = (int)ceilf(box.max[u]) - 1;
+    int v_first = (int)floorf(box.min[v]);
+    int v_last = (int)ceilf(box.max[v]) - 1;
+
+    // Layers of blocks entered by the leading face, nearest first, up to the
+    // skin past the end so moves shorter than it never end flush on a block
+    float leading = delta > 0 ? box.max[axis] : box.min[axis];
+    int first = delta > 0 ? (int)ceilf(leading) : (int)floorf(leading) - 1;
+    int last = delta > 0 ? (int)ceilf(leading + delta + SKIN) - 1 : (int)floorf(leading + delta - SKIN);
+    int step = delta > 0 ? 1 : -1;
+
+    for (int layer = first; layer != last + step; layer += step) {
+        for (int a = u_first; a <= u_last; a++) {
+            for (int b = v_first; b <= v_last; b++) {
+                glm::ivec3 cell;
+                cell[axis] = layer;
+                cell[u] = a;
+                cell[v] = b;
+                if (is_solid(cell)) {
+                    float allowed = delta > 0 ? layer - leading - SKIN : layer + 1 - leading + SKIN;
+                    // Already in the skin, never move backwards
+                    return delta > 0 ? std::max(allowed, 0.0f) : std::min(allowed, 0.0f);
+                }
+            }
+        }
+    }
+    return delta;
+}
+
+glm::vec3 VoxelCollider::move(Aabb& box, glm::vec3 delta, glm::bvec3& blocked)
+{
+    glm::vec3 moved(0.0f);
+    for (int axis : {1, 0, 2}) {
+        moved[axis] = sweep_axis(box, axis, delta[axis]);
+        blocked[axis] = moved[axis] != delta[axis];
+        box.min[axis] += moved[axis];
+        box.max[axis] += moved[axis];
+    }
+    return moved;
+}
@@ -0,0 +1,238 @@
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+#include "EntityStore.hpp"
+
+SpatialHash::SpatialHash(float cell_size, size_t bucket_count) : cell_size(cell_size)
+{
+    size_t buckets = 1;
+    while (buckets < bucket_count) {
+        buckets <<= 1;
+    }
+    bucket_mask = buckets - 1;
+    bucket_start.resize(buckets + 1);
+}
+
+glm::ivec3 SpatialHash::get_cell(glm::vec3 pos) const
+{
+    return glm::ivec3((int)floorf(pos.x / cell_size), (int)floorf(pos.y / cell_size), (int)floorf(pos.z / cell_size));
+}
+
+size_t SpatialHash::get_bucket(glm::ivec3 cell) const
+{
+    uint32_t hash = (uint32_t)cell.x * 73856093u ^ (uint32_t)cell.y * 19349663u ^ (uint32_t)cell.z * 83492791u;
+    return hash & bucket_mask;
+}
+
+void SpatialHash::build(const float* x, const float* y, const float* z, size_t count)
+{
+    entries.resize(count);
+    entity_buckets.resize(count);
+    std::fill(bucket_start.begin(), bucket_start.end(), 0);
+
+    for (size_t i = 0; i < count; i++) {
+        entity_buckets[i] = get_bucket(get_cell(glm::vec3(x[i], y[i], z[i])));
+        bucket_start[entity_buckets[i]]++;
+    }
+    // Ends of the buckets, filling each one from its end moves them back to
+    // the starts and keeps the entities in order
+    for (size_t b = 1; b <= bucket_mask; b++) {
+        bucket_start[b] += bucket_start[b - 1];
+    }
+    bucket_start[bucket_mask + 1] = count;
+    for (size_t i = count; i-- > 0;) {
+        entries[--bucket_start[entity_buckets[i]]] = i;
+    }
+}
+
+void SpatialHash::query(glm::vec3 min, glm::vec3 max, std::vector<uint32_t>& found) const
+{
+    glm::ivec3 first = get_cell(min);
+    glm::ivec3 last = get_cell(max);
+    // Queries cover a few cells, a list is enough to skip shared buckets.
+    // It holds every cell so larger queries still add each bucket once.
+    size_t cells = (size_t)(last.x - first.x + 1) * (last.y - first.y + 1) * (last.z - first.z + 1);
+    size_t small_visited[64];
+    std::vector<size_t> large_visited;
+    if (cells > 64) {
+        large_visited.resize(cells);
+    }
+    size_t* visited = cells > 64 ? large_visited.data() : small_visited;
+    size_t visited_count = 0;
+
+    for (int x = first.x; x <= last.x; x++) {
+        for (int y = first.y; y <= last.y; y++) {
+            for (int z = first.z; z <= last.z; z++) {
+                size_t bucket = get_bucket(glm::ivec3(x, y, z));
+                if (std::find(visited, visited + visited_count, bucket) != visited + visited_count) {
+                    continue;
+                }
+                visited[visited_count++] = bucket;
+                found.insert(found.end(), entries.begin() + bucket_start[bucket], entries.begin() + bucket_start[bucket + 1]);
+            }
+        }
+    }
+}
+
+EntityStore::EntityStore(size_t capacity) : capacity(capacity)
+{
+    pos_x.resize(capacity);
+    pos_y.resize(capacity);
+    pos_z.resize(capacity);
+    vel_x.resize(capacity);
+    vel_y.resize(capacity);
+    vel_z.resize(capacity);
+    half_x.resize(capacity);
+    half_y.resize(capacity);
+    half_z.resize(capacity);
+    type.resize(capacity);
+    on_ground.resize(capacity);
+}
+
+bool EntityStore::spawn(EntityType entity_type, glm::vec3 pos, glm::vec3 half_extents, glm::vec3 velocity)
+{
+    if (count >= capacity) {
+        return false;
+    }
+
+    pos_x[count] = pos.x;
+    pos_y[count] = pos.y;
+    pos_z[count] = pos.z;
+    vel_x[count] = velocity.x;
+    vel_y[count] = velocity.y;
+    vel_z[count] = velocity.z;
+    half_x[count] = half_extents.x;
+    half_y[count] = half_extents.y;
+    half_z[count] = half_extents.z;
+    type[count] = entity_type;
+    on_ground[count] = false;
+    max_half_extent = std::max({max_half_extent, half_extents.x, half_extents.y, half_extents.z});
+    count++;
+    return true;
+}
+
+void EntityStore::remove(size_t index)
+{
+    // Swaps the last entity in, like ParticlePool::remove
+    count--;
+    pos_x[index] = pos_x[count];
+    pos_y[index] = pos_y[count];
+    pos_z[index] = pos_z[count];
+    vel_x[index] = vel_x[count];
+    vel_y[index] = vel_y[count];
+    vel_z[index] = vel_z[count];
+    half_x[index] = half_x[count];
+    half_y[index] = half_y[count];
+    half_z[index] = half_z[count];
+    type[index] = type[count];
+    on_ground[index] = on_ground[count];
+}
+
+Aabb EntityStore::get_box(size_t index) const
+{
+    glm::vec3 pos(pos_x[index], pos_y[index], pos_z[index]);
+    glm::vec3 half(half_x[index], half_y[index], half_z[index]);
+    return {pos - half, pos + half};
+}
+
+void EntityStore::separate(size_t begin, size_t end)
+{
+    // Only reads the other positions and writes the own velocity, so batches
+    // can run at the same time
+    std::vector<uint32_t> candidates;
+    size_t tests = 0;
+    for (size_t i = begin; i < end; i++) {
+        if (type[i] != ENTITY_MOB) {
+            continue;
+        }
+        Aabb box = get_box(i);
+        candidates.clear();
+        grid.query(box.min - max_half_extent, box.max + max_half_extent, candidates);
+        for (uint32_t j : candidates) {
+            if (j == i || type[j] != ENTITY_MOB) {
+                continue;
+            }
+            tests++;
+            // Overlaps from the centers, no box is built for the candidates
+            float dx = pos_x[i] - pos_x[j];
+            float dz = pos_z[i] - pos_z[j];
+            float overlap_x = half_x[i] + half_x[j] - fabsf(dx);
+            float overlap_y = half_y[i] + half_y[j] - fabsf(pos_y[i] - pos_y[j]);
+            float overlap_z = half_z[i] + half_z[j] - fabsf(dz);
+            if (overlap_x <= 0 || overlap_y <= 0 || overlap_z <= 0) {
+                continue;
+            }
+            // Pushed horizontally along the shallower overlap, away from the
+            // other one or by index when they share a center
+            if (overlap_x < overlap_z) {
+                vel_x[i] += (dx < 0 || (dx == 0 && i < j) ? -overlap_x : overlap_x) * SEPARATION;
+            } else {
+                vel_z[i] += (dz < 0 || (dz == 0 && i < j) ? -overlap_z : overlap_z) * SEPARATION;
+            }
+        }
+    }
+    pair_tests += tests;
+}
+
+void EntityStore::move(size_t begin, size_t end, std::vector<Chunk>& world)
+{
+    // The collider caches its last chunk, each batch has its own and the
+    // world does not change during the update
+    VoxelCollider collider(world);
+    float* __restrict vx = vel_x.data();
+    float* __restrict vy = vel_y.data();
+    float* __restrict vz = vel_z.data();
+
+    for (size_t i = begin; i < end; i++) {
+        vy[i] = std::min(vy[i] + GRAVITY, TERMINAL_VELOCITY);
+    }
+    for (size_t i = begin; i < end; i++) {
+        Aabb box = get_box(i);
+        glm::bvec3 blocked;
+        collider.move(box, glm::vec3(vx[i], vy[i], vz[i]), blocked);
+        pos_x[i] = (box.min.x + box.max.x) * 0.5f;
+        pos_y[i] = (box.min.y + box.max.y) * 0.5f;
+        pos_z[i] = (box.min.z + box.max.z) * 0.5f;
+        on_ground[i] = blocked.y && vy[i] > 0;
+        vx[i] = blocked.x ? 0.0f : vx[i];
+        vy[i] = blocked.y ? 0.0f : vy[i];
+        vz[i] = blocked.z ? 0.0f : vz[i];
+    }
+    for (size_t i = begin; i < end; i++) {
+        float friction = on_ground[i] ? GROUND_FRICTION : AIR_FRICTION;
+        vx[i] *= friction;
+        vz[i] *= friction;
+    }
+}
+
+void EntityStore::update(std::vector<Chunk>& world, ThreadPool* pool)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    grid.build(pos_x.data(), pos_y.data(), pos_z.data(), count);
+    auto built = std::chrono::high_resolution_clock::now();
+    hash_ms = std::chrono::duration<float, std::chrono::milliseconds::period>(built - start).count();
+
+    pair_tests = 0;
+    size_t batches = (count + BATCH_SIZE - 1) / BATCH_SIZE;
+    // Ahead of any chunk work, the tick waits for these
+    int priority = std::numeric_limits<int>::min();
+    auto run = [&](const std::function<void(size_t)>& batch) {
+        if (pool) {
+            pool->run_batches(batches, batch, priority);
+        } else {
+            for (size_t b = 0; b < batches; b++) {
+                batch(b);
+            }
+        }
+    };
+    // Every push is computed from the positions before anything moves
+    run([this](size_t b) {
+        separate(b * BATCH_SIZE, std::min(count, (b + 1) * BATCH_SIZE));
+    });
+    run([this, &world](size_t b) {
+        move(b * BATCH_SIZE, std::min(count, (b + 1) * BATCH_SIZE), world);
+    });
+    physics_ms = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - built).count();
+}
@@ -0,0 +1,313 @@
+#include <chrono>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "IoService.hpp"
+
+IoService::IoService(size_t thread_count)
+{
+#if BASSICRAFT_IO_URING
+    use_io_uring = io_uring_queue_init(QUEUE_DEPTH, &ring, 0) == 0;
+#endif
+    if (!use_io_uring) {
+        for (size_t i = 0; i < thread_count; i++) {
+            workers.emplace_back(&IoService::worker_loop, this);
+        }
+    }
+}
+
+IoService::~IoService()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+#if BASSICRAFT_IO_URING
+    if (use_io_uring) {
+        io_uring_queue_exit(&ring);
+    }
+#endif
+}
+
+void IoService::read(int fd, uint64_t offset, size_t size, int priority, uint64_t key, Callback callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests++;
+        auto found = reads_by_key.find(key);
+        if (found != reads_by_key.end() && found->second->fd == fd && found->second->offset == offset && found->second->size == size) {
+            found->second->callbacks.push_back(std::move(callback));
+            found->second->priority = std::min(found->second->priority, priority);
+            coalesced_requests++;
+            return;
+        }
+        auto request = std::make_shared<Request>();
+        request->fd = fd;
+        request->offset = offset;
+        request->size = size;
+        request->priority = priority;
+        request->order = next_order++;
+        request->key = key;
+        request->callbacks.push_back(std::move(callback));
+        queue.push_back(request);
+        reads_by_key[key] = request;
+    }
+    condition.notify_one();
+}
+
+void IoService::write(int fd, uint64_t offset, std::vector<uint8_t> data, int priority, Callback callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests++;
+        auto request = std::make_shared<Request>();
+        request->is_write = true;
+        request->fd = fd;
+        request->offset = offset;
+        request->size = data.size();
+        request->priority = priority;
+        request->order = next_order++;
+        // A newer write of the same bytes replaces a queued one, unless
+        // another request for some of them was queued in between
+        std::shared_ptr<Request> latest;
+        for (auto& other : queue) {
+            if (overlaps(*other, *request) && (!latest || other->order > latest->order)) {
+                latest = other;
+            }
+        }
+        if (latest && latest->is_write && latest->offset == offset && latest->size == data.size()) {
+            latest->data = std::move(data);
+            latest->callbacks.push_back(std::move(callback));
+            latest->priority = std::min(latest->priority, priority);
+            coalesced_requests++;
+            return;
+        }
+        request->data = std::move(data);
+        request->callbacks.push_back(std::move(callback));
+        queue.push_back(request);
+    }
+    condition.notify_one();
+}
+
+size_t IoService::get_queued()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size() + in_flight;
+}
+
+bool IoService::overlaps(const Request& a, const Request& b)
+{
+    return a.fd == b.fd && (a.is_write || b.is_write) && a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+
+bool IoService::is_blocked(const Request& request)
+{
+    // Requests touching the same bytes as a write run in the order they
+    // were made, whatever their priority
+    for (auto& other : running) {
+        if (overlaps(*other, request)) {
+            return true;
+        }
+    }
+    for (auto& other : queue) {
+        if (other->order < request.order && overlaps(*other, request)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::shared_ptr<IoService::Request>>::iterator IoService::find_next()
+{
+    auto next = queue.end();
+    for (auto it = queue.begin(); it != queue.end(); it++) {
+        auto& request = *it;
+        bool earlier = next == queue.end() || (request->priority != (*next)->priority ? request->priority < (*next)->priority : request->order < (*next)->order);
+        if (earlier && !is_blocked(*request)) {
+            next = it;
+        }
+    }
+    return next;
+}
+
+std::unique_ptr<IoService::Batch> IoService::next_batch()
+{
+    auto first = find_next();
+    if (first == queue.end()) {
+        return nullptr;
+    }
+    auto batch = std::make_unique<Batch>();
+    batch->requests.push_back(*first);
+    batch->is_write = (*first)->is_write;
+    batch->fd = (*first)->fd;
+    batch->offset = (*first)->offset;
+    uint64_t end = (*first)->offset + (*first)->size;
+    running.push_back(*first);
+    queue.erase(first);
+
+    if (batch->is_write) {
+        batch->buffer = std::move(batch->requests[0]->data);
+        return batch;
+    }
+
+    // Reads of the sectors right before or after go in the same call
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (auto it = queue.begin(); it != queue.end(); it++) {
+            auto& request = *it;
+            if (request->is_write || request->fd != batch->fd || end - batch->offset + request->size > MAX_BATCH_SIZE || is_blocked(*request)) {
+                continue;
+            }
+            if (request->offset == end) {
+                end += request->size;
+            } else if (request->offset + request->size == batch->offset) {
+                batch->offset = request->offset;
+            } else {
+                continue;
+            }
+            batch->requests.push_back(request);
+            running.push_back(request);
+            queue.erase(it);
+            merged_reads++;
+            merged = true;
+            break;
+        }
+    }
+    batch->buffer.resize(end - batch->offset);
+    return batch;
+}
+
+void IoService::run_batch(Batch& batch)
+{
+    size_t done = 0;
+    while (done < batch.buffer.size()) {
+        ssize_t result;
+        if (batch.is_write) {
+            result = pwrite(batch.fd, batch.buffer.data() + done, batch.buffer.size() - done, batch.offset + done);
+        } else {
+            result = pread(batch.fd, batch.buffer.data() + done, batch.buffer.size() - done, batch.offset + done);
+        }
+        if (result <= 0) {
+            break;
+        }
+        done += result;
+    }
+    batch.ok = done == batch.buffer.size();
+}
+
+void IoService::finish_batch(std::unique_ptr<Batch> batch)
+{
+    for (auto& request : batch->requests) {
+        running.erase(std::find(running.begin(), running.end(), request));
+    }
+    completed.push_back(std::move(batch));
+    in_flight--;
+    // Requests waiting on this one can start
+    condition.notify_all();
+}
+
+void IoService::worker_loop()
+{
+    while (true) {
+        std::unique_ptr<Batch> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this, &batch] { return stopping || (batch = next_batch()) != nullptr; });
+            if (stopping) {
+                return;
+            }
+            in_flight++;
+        }
+        run_batch(*batch);
+        std::lock_guard<std::mutex> lock(mutex);
+        finish_batch(std::move(batch));
+    }
+}
+
+size_t IoService::poll()
+{
+#if BASSICRAFT_IO_URING
+    if (use_io_uring) {
+        struct io_uring_cqe* cqe;
+        while (io_uring_peek_cqe(&ring, &cqe) == 0) {
+            std::unique_ptr<Batch> batch((Batch*)io_uring_cqe_get_data(cqe));
+            // Short transfers count as failures, regular files don't do them
+            batch->ok = cqe->res == (int)batch->buffer.size();
+            io_uring_cqe_seen(&ring, cqe);
+            std::lock_guard<std::mutex> lock(mutex);
+            finish_batch(std::move(batch));
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        bool submitted = false;
+        while (in_flight < QUEUE_DEPTH && find_next() != queue.end()) {
+            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+            if (!sqe) {
+                break;
+            }
+            Batch* batch = next_batch().release();
+            if (batch->is_write) {
+                io_uring_prep_write(sqe, batch->fd, batch->buffer.data(), batch->buffer.size(), batch->offset);
+            } else {
+                io_uring_prep_read(sqe, batch->fd, batch->buffer.data(), batch->buffer.size(), batch->offset);
+            }
+            io_uring_sqe_set_data(sqe, batch);
+            in_flight++;
+            submitted = true;
+        }
+        lock.unlock();
+        if (submitted) {
+            io_uring_submit(&ring);
+        }
+    }
+#endif
+
+    std::vector<std::shared_ptr<Request>> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& batch : completed) {
+            for (auto& request : batch->requests) {
+                request->ok = batch->ok;
+                if (!request->is_write && batch->ok) {
+                    auto start = batch->buffer.begin() + (request->offset - batch->offset);
+                    request->data.assign(start, start + request->size);
+                }
+                // Later reads of the key get a request of their own
+                auto found = reads_by_key.find(request->key);
+                if (!request->is_write && found != reads_by_key.end() && found->second == request) {
+                    reads_by_key.erase(found);
+                }
+                done.push_back(request);
+            }
+        }
+        completed.clear();
+    }
+
+    size_t count = 0;
+    for (auto& request : done) {
+        for (auto& callback : request->callbacks) {
+            callback(request->ok, request->data);
+            count++;
+        }
+    }
+    return count;
+}
+
+void IoService::wait()
+{
+    while (true) {
+        poll();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.empty() && in_flight == 0 && completed.empty()) {
+                return;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
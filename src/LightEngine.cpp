@@ -0,0 +1,314 @@
+#include <chrono>
+#include <algorithm>
+#include <limits>
+
+#include "LightEngine.hpp"
+
+static const glm::ivec3 DIRECTIONS[6] = {
+    {0, -1, 0},
+    {0, 1, 0},
+    {-1, 0, 0},
+    {1, 0, 0},
+    {0, 0, -1},
+    {0, 0, 1}
+};
+// Index in DIRECTIONS of +y, towards the ground
+static const int DOWN = 1;
+
+LightEngine::LightEngine()
+{
+    // Glowstone, lava and torch tiles of the atlas
+    emission[106] = 15;
+    emission[238] = 15;
+    emission[81] = 14;
+}
+
+uint8_t LightEngine::get_light(const Chunk& chunk, glm::ivec3 pos, int channel)
+{
+    uint8_t packed = chunk.light[(pos.x * 100 + pos.y) * 16 + pos.z];
+    return channel == CHANNEL_SKY ? packed >> 4 : packed & 0xf;
+}
+
+void LightEngine::set_light(Chunk& chunk, glm::ivec3 pos, int channel, uint8_t level)
+{
+    uint8_t& packed = chunk.light[(pos.x * 100 + pos.y) * 16 + pos.z];
+    if (channel == CHANNEL_SKY) {
+        packed = (packed & 0x0f) | (level << 4);
+    } else {
+        packed = (packed & 0xf0) | level;
+    }
+}
+
+void LightEngine::set_world(std::vector<Chunk>& world)
+{
+    chunks.set_world(world);
+    last_chunk = nullptr;
+}
+
+Chunk* LightEngine::resolve(glm::ivec3 pos, Chunk* only, glm::ivec3& local)
+{
+    if (pos.y < 0 || pos.y >= 100) {
+        return nullptr;
+    }
+    // Floor division, chunk -1 holds x -16 to -1
+    glm::ivec2 chunk_pos(pos.x >> 4, pos.z >> 4);
+    local = glm::ivec3(pos.x & 15, pos.y, pos.z & 15);
+    if (only) {
+        return glm::ivec2(only->pos) == chunk_pos ? only : nullptr;
+    }
+    // Most lookups land in the chunk of the one before
+    if (last_chunk && glm::ivec2(last_chunk->pos) == chunk_pos) {
+        return last_chunk;
+    }
+    Chunk* found = chunks.find(chunk_pos);
+    if (found) {
+        last_chunk = found;
+    }
+    return found;
+}
+
+void LightEngine::mark_changed(Chunk* chunk, Chunk* only)
+{
+    if (!only && !chunk->light_dirty) {
+        chunk->light_dirty = true;
+        relit_chunks++;
+    }
+}
+
+size_t LightEngine::propagate(std::vector<LightNode>& queue, int channel, Chunk* only)
+{
+    size_t visited = 0;
+    for (size_t i = 0; i < queue.size(); i++) {
+        glm::ivec3 local;
+        Chunk* chunk = resolve(queue[i].pos, only, local);
+        // Nodes can be queued before a removal lowers them, spread what is
+        // there now
+        uint8_t current = chunk ? get_light(*chunk, local, channel) : 0;
+        if (current <= 1) {
+            continue;
+        }
+        visited++;
+        for (int d = 0; d < 6; d++) {
+            glm::ivec3 pos = queue[i].pos + DIRECTIONS[d];
+            Chunk* neighbour = resolve(pos, only, local);
+            if (!neighbour || !Chunk::see_through[neighbour->blocks[local.x][local.y][local.z].type]) {
+                continue;
+            }
+            uint8_t level = channel == CHANNEL_SKY && d == DOWN && current == 15 ? 15 : current - 1;
+            if (get_light(*neighbour, local, channel) >= level) {
+                continue;
+            }
+            set_light(*neighbour, local, channel, level);
+            mark_changed(neighbour, only);
+            queue.push_back({pos, level});
+        }
+    }
+    return visited;
+}
+
+size_t LightEngine::remove(std::vector<LightNode>& queue, std::vector<LightNode>& readd, int channel, Chunk* only)
+{
+    // Every block lit through a removed one loses its light, brighter ones
+    // have another source and spread back over the hole afterwards
+    for (size_t i = 0; i < queue.size(); i++) {
+        LightNode node = queue[i];
+        for (int d = 0; d < 6; d++) {
+            glm::ivec3 local;
+            glm::ivec3 pos = node.pos + DIRECTIONS[d];
+            Chunk* neighbour = resolve(pos, only, local);
+            if (!neighbour) {
+                continue;
+            }
+            uint8_t level = get_light(*neighbour, local, channel);
+            if (level == 0) {
+                continue;
+            }
+            bool sky_column = channel == CHANNEL_SKY && d == DOWN && node.level == 15;
+            if (level < node.level || sky_column) {
+                set_light(*neighbour, local, channel, 0);
+                mark_changed(neighbour, only);
+                queue.push_back({pos, level});
+                uint8_t emitted = channel == CHANNEL_BLOCK ? emission[neighbour->blocks[local.x][local.y][local.z].type] : 0;
+                if (emitted > 0) {
+                    set_light(*neighbour, local, channel, emitted);
+                    readd.push_back({pos, emitted});
+                }
+            } else {
+                readd.push_back({pos, level});
+            }
+        }
+    }
+    return queue.size();
+}
+
+void LightEngine::light_chunk(Chunk& chunk)
+{
+    chunk.light.fill(0);
+    glm::ivec3 origin(chunk.pos.x * 16, 0, chunk.pos.y * 16);
+    std::vector<LightNode> sky;
+    std::vector<LightNode> block;
+
+    for (int x = 0; x < 16; x++) {
+        for (int z = 0; z < 16; z++) {
+            int surface = chunk.get_surface(x, z);
+            for (int y = 0; y < surface; y++) {
+                set_light(chunk, glm::ivec3(x, y, z), CHANNEL_SKY, 15);
+            }
+            // Sky blocks above every neighbouring surface only reach blocks
+            // lit by the sky already
+            int lowest = surface;
+            for (int side = 0; side < 4; side++) {
+                int nx = x + DIRECTIONS[2 + side].x;
+                int nz = z + DIRECTIONS[2 + side].z;
+                if (nx >= 0 && nx < 16 && nz >= 0 && nz < 16) {
+                    lowest = std::min(lowest, chunk.get_surface(nx, nz));
+                }
+            }
+            for (int y = lowest; y < surface; y++) {
+                sky.push_back({origin + glm::ivec3(x, y, z), 15});
+            }
+            for (int y = 0; y < 100; y++) {
+                uint8_t emitted = emission[chunk.blocks[x][y][z].type];
+                if (emitted > 0) {
+                    set_light(chunk, glm::ivec3(x, y, z), CHANNEL_BLOCK, emitted);
+                    block.push_back({origin + glm::ivec3(x, y, z), emitted});
+                }
+            }
+        }
+    }
+    propagate(sky, CHANNEL_SKY, &chunk);
+    propagate(block, CHANNEL_BLOCK, &chunk);
+}
+
+void LightEngine::stitch_chunk(Chunk& chunk)
+{
+    stitch_chunks({&chunk});
+}
+
+void LightEngine::stitch_chunks(const std::vector<Chunk*>& stitched)
+{
+    // Spreads the light on both sides of each border with a loaded chunk
+    // over the other side, a border between two stitched chunks is queued
+    // once
+    for (int channel = 0; channel < CHANNEL_COUNT; channel++) {
+        std::vector<LightNode> queue;
+        for (size_t c = 0; c < stitched.size(); c++) {
+            glm::ivec3 origin(stitched[c]->pos.x * 16, 0, stitched[c]->pos.y * 16);
+            for (int side = 0; side < 4; side++) {
+                glm::ivec3 normal = DIRECTIONS[2 + side];
+                glm::ivec3 along = normal.x != 0 ? glm::ivec3(0, 0, 1) : glm::ivec3(1, 0, 0);
+                // First block of the chunk on that border
+                glm::ivec3 start = origin + glm::ivec3(normal.x > 0 ? 15 : 0, 0, normal.z > 0 ? 15 : 0);
+                glm::ivec3 local;
+                Chunk* neighbour = resolve(start + normal, nullptr, local);
+                if (!neighbour || std::find(stitched.begin(), stitched.begin() + c, neighbour) != stitched.begin() + c) {
+                    continue;
+                }
+                for (int i = 0; i < 16; i++) {
+                    for (int y = 0; y < 100; y++) {
+                        glm::ivec3 pos = start + along * i + glm::ivec3(0, y, 0);
+                        queue.push_back({pos, 0});
+                        queue.push_back({pos + normal, 0});
+                    }
+                }
+            }
+        }
+        propagate(queue, channel, nullptr);
+    }
+}
+
+bool LightEngine::copy_border_light(Chunk& chunk)
+{
+    bool changed = false;
+    for (int side = 0; side < 4; side++) {
+        glm::ivec3 normal = DIRECTIONS[2 + side];
+        Chunk* found = chunks.find(glm::ivec2(chunk.pos) + glm::ivec2(normal.x, normal.z));
+        std::array<uint8_t, 100 * 16> border;
+        if (!found) {
+            border.fill(0xf0);
+        } else {
+            // The first blocks of the neighbour on the shared side
+            const Chunk& neighbour = *found;
+            for (int y = 0; y < 100; y++) {
+                for (int i = 0; i < 16; i++) {
+                    int x = normal.x < 0 ? 15 : normal.x > 0 ? 0 : i;
+                    int z = normal.z < 0 ? 15 : normal.z > 0 ? 0 : i;
+                    border[y * 16 + i] = neighbour.light[(x * 100 + y) * 16 + z];
+                }
+            }
+        }
+        if (border != chunk.border_light[side]) {
+            chunk.border_light[side] = border;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+std::vector<Chunk*> LightEngine::relight_chunks(const std::vector<Chunk*>& edited, ThreadPool& pool)
+{
+    // Light spreads at most 15 blocks, relighting the edited chunks and the
+    // ring around them then joining their borders gives the same light as
+    // lighting the world again
+    std::vector<Chunk*> relit = edited;
+    for (Chunk* chunk : edited) {
+        chunk->compute_heightmap();
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dz = -1; dz <= 1; dz++) {
+                Chunk* neighbour = chunks.find(glm::ivec2(chunk->pos) + glm::ivec2(dx, dz));
+                if (neighbour && std::find(relit.begin(), relit.end(), neighbour) == relit.end()) {
+                    relit.push_back(neighbour);
+                }
+            }
+        }
+    }
+    pool.run_batches(relit.size(), [&](size_t i) { light_chunk(*relit[i]); }, std::numeric_limits<int>::min());
+    last_chunk = nullptr;
+    stitch_chunks(relit);
+    for (Chunk* chunk : relit) {
+        copy_border_light(*chunk);
+    }
+    return relit;
+}
+
+void LightEngine::update_block(glm::ivec3 pos, uint16_t old_type)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    glm::ivec3 local;
+    Chunk* chunk = resolve(pos, nullptr, local);
+    if (!chunk) {
+        return;
+    }
+    uint16_t type = chunk->blocks[local.x][local.y][local.z].type;
+    last_nodes = 0;
+
+    // Every block the edit can darken is within 15 blocks, or below it in
+    // its sky column, so each channel walks at most that area twice
+    for (int channel = 0; channel < CHANNEL_COUNT; channel++) {
+        std::vector<LightNode> removal;
+        std::vector<LightNode> readd;
+        uint8_t level = get_light(*chunk, local, channel);
+        if (level > 0 && (!Chunk::see_through[type] || (channel == CHANNEL_BLOCK && emission[old_type] > 0))) {
+            set_light(*chunk, local, channel, 0);
+            mark_changed(chunk, nullptr);
+            removal.push_back({pos, level});
+            last_nodes += remove(removal, readd, channel, nullptr);
+        }
+        // The top layer is lit by the sky itself, not by a block above
+        uint8_t emitted = channel == CHANNEL_BLOCK ? emission[type] : Chunk::see_through[type] && pos.y == 0 ? 15 : 0;
+        if (emitted > 0) {
+            set_light(*chunk, local, channel, emitted);
+            mark_changed(chunk, nullptr);
+            readd.push_back({pos, emitted});
+        }
+        if (Chunk::see_through[type]) {
+            for (int d = 0; d < 6; d++) {
+                readd.push_back({pos + DIRECTIONS[d], 0});
+            }
+        }
+        last_nodes += propagate(readd, channel, nullptr);
+    }
+
+    last_ms = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+    worst_ms = std::max(worst_ms, last_ms);
+}
@@ -0,0 +1,140 @@
+#include <cstring>
+#include <algorithm>
+
+#include "Lz4.hpp"
+
+static const int MIN_MATCH = 4;
+// The block format ends with at least 5 literals and its last match starts
+// 12 bytes or more before the end
+static const size_t LAST_LITERALS = 5;
+static const size_t MATCH_LIMIT = 12;
+static const int HASH_BITS = 12;
+
+static uint32_t read32(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+static uint32_t hash32(uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void write_length(std::vector<uint8_t>& dst, size_t length)
+{
+    while (length >= 255) {
+        dst.push_back(255);
+        length -= 255;
+    }
+    dst.push_back((uint8_t)length);
+}
+
+static void write_sequence(std::vector<uint8_t>& dst, const uint8_t* literals, size_t literal_count, size_t offset, size_t match_length)
+{
+    size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+    dst.push_back((uint8_t)((literal_count < 15 ? literal_count : 15) << 4 | (match_code < 15 ? match_code : 15)));
+    if (literal_count >= 15) {
+        write_length(dst, literal_count - 15);
+    }
+    dst.insert(dst.end(), literals, literals + literal_count);
+    if (match_length == 0) {
+        return;
+    }
+    dst.push_back((uint8_t)offset);
+    dst.push_back((uint8_t)(offset >> 8));
+    if (match_code >= 15) {
+        write_length(dst, match_code - 15);
+    }
+}
+
+void lz4_compress(const uint8_t* src, size_t size, std::vector<uint8_t>& dst)
+{
+    dst.clear();
+    dst.reserve(size / 2 + 16);
+    std::vector<uint32_t> table(1 << HASH_BITS, UINT32_MAX);
+    size_t anchor = 0;
+    size_t i = 0;
+
+    while (size > MATCH_LIMIT && i < size - MATCH_LIMIT) {
+        uint32_t sequence = read32(src + i);
+        uint32_t h = hash32(sequence);
+        uint32_t candidate = table[h];
+        table[h] = (uint32_t)i;
+        if (candidate == UINT32_MAX || i - candidate > 65535 || read32(src + candidate) != sequence) {
+            i++;
+            continue;
+        }
+        size_t length = MIN_MATCH;
+        while (i + length < size - LAST_LITERALS && src[candidate + length] == src[i + length]) {
+            length++;
+        }
+        write_sequence(dst, src + anchor, i - anchor, i - candidate, length);
+        i += length;
+        anchor = i;
+    }
+    write_sequence(dst, src + anchor, size - anchor, 0, 0);
+}
+
+bool lz4_decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t size)
+{
+    const uint8_t* end = src + src_size;
+    size_t out = 0;
+
+    auto read_length = [&](size_t& length) {
+        uint8_t byte = 255;
+        while (byte == 255) {
+            if (src >= end) {
+                return false;
+            }
+            byte = *src++;
+            length += byte;
+        }
+        return true;
+    };
+
+    while (src < end) {
+        uint8_t token = *src++;
+        size_t literal_count = token >> 4;
+        if (literal_count == 15 && !read_length(literal_count)) {
+            return false;
+        }
+        if (literal_count > (size_t)(end - src) || literal_count > size - out) {
+            return false;
+        }
+        memcpy(dst + out, src, literal_count);
+        src += literal_count;
+        out += literal_count;
+        if (src == end) {
+            break;
+        }
+
+        if (end - src < 2) {
+            return false;
+        }
+        size_t offset = src[0] | (src[1] << 8);
+        src += 2;
+        size_t length = token & 15;
+        if (length == 15 && !read_length(length)) {
+            return false;
+        }
+        length += MIN_MATCH;
+        if (offset == 0 || offset > out || length > size - out) {
+            return false;
+        }
+        // An overlapping match repeats its first offset bytes, copying from
+        // the start doubles what is available for the next copy
+        const uint8_t* from = dst + out - offset;
+        uint8_t* to = dst + out;
+        size_t left = length;
+        while (left > 0) {
+            size_t count = std::min(left, (size_t)(to - from));
+            memcpy(to, from, count);
+            to += count;
+            left -= count;
+        }
+        out += length;
+    }
+    return out == size;
+}
@@ -0,0 +1,300 @@
+#include "NoiseBatch.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NOISE_BATCH_X86
+#include <immintrin.h>
+#endif
+
+// Same constants and operation order as FastNoiseLite::SingleSimplex and
+// TransformNoiseCoordinate, any reordering breaks bit-identity
+static const float SQRT3 = 1.7320508075688772935274463415059f;
+static const float F2 = 0.5f * (SQRT3 - 1);
+static const float G2 = (3 - SQRT3) / 6;
+static const float C_T = (float)(2 * (1 - 2 * G2) * (1 / G2 - 2));
+static const float C_A = (float)(-2 * (1 - 2 * G2) * (1 - 2 * G2));
+static const float G2_2 = 2 * (float)G2 - 1;
+static const float G2_1 = (float)G2 - 1;
+static const float SIMPLEX_SCALE = 99.83685446303647f;
+static const int PRIME_X = 501125321;
+static const int PRIME_Y = 1136930381;
+
+bool NoiseBatch::is_vectorisable(const FastNoiseLite& noise)
+{
+    return noise.mNoiseType == FastNoiseLite::NoiseType_OpenSimplex2 &&
+        (noise.mFractalType == FastNoiseLite::FractalType_None || noise.mFractalType == FastNoiseLite::FractalType_FBm);
+}
+
+void NoiseBatch::get_noise_grid_scalar(const FastNoiseLite& noise, float x0, float z0, float* out)
+{
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int z = 0; z < GRID_SIZE; z++) {
+            out[x * GRID_SIZE + z] = noise.GetNoise(x + x0, z + z0);
+        }
+    }
+}
+
+#ifdef NOISE_BATCH_X86
+
+__attribute__((target("sse4.1")))
+static inline __m128 grad_sse41(__m128i seed, __m128i x_primed, __m128i y_primed, __m128 xd, __m128 yd, const float* gradients)
+{
+    __m128i hash = _mm_xor_si128(_mm_xor_si128(seed, x_primed), y_primed);
+    hash = _mm_mullo_epi32(hash, _mm_set1_epi32(0x27d4eb2d));
+    hash = _mm_xor_si128(hash, _mm_srai_epi32(hash, 15));
+    hash = _mm_and_si128(hash, _mm_set1_epi32(127 << 1));
+
+    alignas(16) int index[4];
+    _mm_store_si128((__m128i*)index, hash);
+    __m128 xg = _mm_setr_ps(gradients[index[0]], gradients[index[1]], gradients[index[2]], gradients[index[3]]);
+    __m128 yg = _mm_setr_ps(gradients[index[0] | 1], gradients[index[1] | 1], gradients[index[2] | 1], gradients[index[3] | 1]);
+
+    return _mm_add_ps(_mm_mul_ps(xd, xg), _mm_mul_ps(yd, yg));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 simplex_sse41(int seed, __m128 x, __m128 y, const float* gradients)
+{
+    __m128 zero = _mm_setzero_ps();
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128i seeds = _mm_set1_epi32(seed);
+
+    // FastFloor: (int)f, minus one for negative values
+    __m128i i = _mm_add_epi32(_mm_cvttps_epi32(x), _mm_castps_si128(_mm_cmplt_ps(x, zero)));
+    __m128i j = _mm_add_epi32(_mm_cvttps_epi32(y), _mm_castps_si128(_mm_cmplt_ps(y, zero)));
+    __m128 xi = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+    __m128 yi = _mm_sub_ps(y, _mm_cvtepi32_ps(j));
+
+    __m128 t = _mm_mul_ps(_mm_add_ps(xi, yi), _mm_set1_ps(G2));
+    __m128 x0 = _mm_sub_ps(xi, t);
+    __m128 y0 = _mm_sub_ps(yi, t);
+
+    i = _mm_mullo_epi32(i, _mm_set1_epi32(PRIME_X));
+    j = _mm_mullo_epi32(j, _mm_set1_epi32(PRIME_Y));
+    __m128i i1 = _mm_add_epi32(i, _mm_set1_epi32(PRIME_X));
+    __m128i j1 = _mm_add_epi32(j, _mm_set1_epi32(PRIME_Y));
+
+    __m128 a = _mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0));
+    __m128 a2 = _mm_mul_ps(a, a);
+    __m128 n0 = _mm_mul_ps(_mm_mul_ps(a2, a2), grad_sse41(seeds, i, j, x0, y0, gradients));
+    n0 = _mm_and_ps(n0, _mm_cmpgt_ps(a, zero));
+
+    __m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(C_T), t), _mm_add_ps(_mm_set1_ps(C_A), a));
+    __m128 x2 = _mm_add_ps(x0, _mm_set1_ps(G2_2));
+    __m128 y2 = _mm_add_ps(y0, _mm_set1_ps(G2_2));
+    __m128 c2 = _mm_mul_ps(c, c);
+    __m128 n2 = _mm_mul_ps(_mm_mul_ps(c2, c2), grad_sse41(seeds, i1, j1, x2, y2, gradients));
+    n2 = _mm_and_ps(n2, _mm_cmpgt_ps(c, zero));
+
+    // y0 > x0 picks the (0, 1) corner, otherwise (1, 0)
+    __m128 upper = _mm_cmpgt_ps(y0, x0);
+    __m128 x1 = _mm_add_ps(x0, _mm_blendv_ps(_mm_set1_ps(G2_1), _mm_set1_ps(G2), upper));
+    __m128 y1 = _mm_add_ps(y0, _mm_blendv_ps(_mm_set1_ps(G2), _mm_set1_ps(G2_1), upper));
+    __m128i x_primed = _mm_blendv_epi8(i1, i, _mm_castps_si128(upper));
+    __m128i y_primed = _mm_blendv_epi8(j, j1, _mm_castps_si128(upper));
+    __m128 b = _mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1));
+    __m128 b2 = _mm_mul_ps(b, b);
+    __m128 n1 = _mm_mul_ps(_mm_mul_ps(b2, b2), grad_sse41(seeds, x_primed, y_primed, x1, y1, gradients));
+    n1 = _mm_and_ps(n1, _mm_cmpgt_ps(b, zero));
+
+    return _mm_mul_ps(_mm_add_ps(_mm_add_ps(n0, n1), n2), _mm_set1_ps(SIMPLEX_SCALE));
+}
+
+__attribute__((target("sse4.1")))
+void NoiseBatch::get_noise_grid_sse41(const FastNoiseLite& noise, float x0, float z0, float* out)
+{
+    const float* gradients = FastNoiseLite::Lookup<float>::Gradients2D;
+    bool fbm = noise.mFractalType == FastNoiseLite::FractalType_FBm;
+    int octaves = fbm ? noise.mOctaves : 1;
+    __m128 frequency = _mm_set1_ps(noise.mFrequency);
+    __m128 lacunarity = _mm_set1_ps(noise.mLacunarity);
+    __m128 gain = _mm_set1_ps(noise.mGain);
+    __m128 weighted_strength = _mm_set1_ps(noise.mWeightedStrength);
+    __m128 one = _mm_set1_ps(1.0f);
+
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int z = 0; z < GRID_SIZE; z += 4) {
+            __m128 xs = _mm_set1_ps(x + x0);
+            __m128 ys = _mm_add_ps(_mm_setr_ps(z, z + 1, z + 2, z + 3), _mm_set1_ps(z0));
+
+            xs = _mm_mul_ps(xs, frequency);
+            ys = _mm_mul_ps(ys, frequency);
+            __m128 t = _mm_mul_ps(_mm_add_ps(xs, ys), _mm_set1_ps(F2));
+            xs = _mm_add_ps(xs, t);
+            ys = _mm_add_ps(ys, t);
+
+            if (!fbm) {
+                _mm_storeu_ps(out + x * GRID_SIZE + z, simplex_sse41(noise.mSeed, xs, ys, gradients));
+                continue;
+            }
+
+            int seed = noise.mSeed;
+            __m128 sum = _mm_setzero_ps();
+            __m128 amp = _mm_set1_ps(noise.mFractalBounding);
+            for (int i = 0; i < octaves; i++) {
+                __m128 value = simplex_sse41(seed++, xs, ys, gradients);
+                sum = _mm_add_ps(sum, _mm_mul_ps(value, amp));
+                __m128 weight = _mm_mul_ps(_mm_min_ps(_mm_add_ps(value, one), _mm_set1_ps(2.0f)), _mm_set1_ps(0.5f));
+                amp = _mm_mul_ps(amp, _mm_add_ps(one, _mm_mul_ps(weighted_strength, _mm_sub_ps(weight, one))));
+
+                xs = _mm_mul_ps(xs, lacunarity);
+                ys = _mm_mul_ps(ys, lacunarity);
+                amp = _mm_mul_ps(amp, gain);
+            }
+            _mm_storeu_ps(out + x * GRID_SIZE + z, sum);
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256 grad_avx2(__m256i seed, __m256i x_primed, __m256i y_primed, __m256 xd, __m256 yd, const float* gradients)
+{
+    __m256i hash = _mm256_xor_si256(_mm256_xor_si256(seed, x_primed), y_primed);
+    hash = _mm256_mullo_epi32(hash, _mm256_set1_epi32(0x27d4eb2d));
+    hash = _mm256_xor_si256(hash, _mm256_srai_epi32(hash, 15));
+    hash = _mm256_and_si256(hash, _mm256_set1_epi32(127 << 1));
+
+    __m256 xg = _mm256_i32gather_ps(gradients, hash, 4);
+    __m256 yg = _mm256_i32gather_ps(gradients, _mm256_or_si256(hash, _mm256_set1_epi32(1)), 4);
+
+    return _mm256_add_ps(_mm256_mul_ps(xd, xg), _mm256_mul_ps(yd, yg));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 simplex_avx2(int seed, __m256 x, __m256 y, const float* gradients)
+{
+    __m256 zero = _mm256_setzero_ps();
+    __m256 half = _mm256_set1_ps(0.5f);
+    __m256i seeds = _mm256_set1_epi32(seed);
+
+    __m256i i = _mm256_add_epi32(_mm256_cvttps_epi32(x), _mm256_castps_si256(_mm256_cmp_ps(x, zero, _CMP_LT_OQ)));
+    __m256i j = _mm256_add_epi32(_mm256_cvttps_epi32(y), _mm256_castps_si256(_mm256_cmp_ps(y, zero, _CMP_LT_OQ)));
+    __m256 xi = _mm256_sub_ps(x, _mm256_cvtepi32_ps(i));
+    __m256 yi = _mm256_sub_ps(y, _mm256_cvtepi32_ps(j));
+
+    __m256 t = _mm256_mul_ps(_mm256_add_ps(xi, yi), _mm256_set1_ps(G2));
+    __m256 x0 = _mm256_sub_ps(xi, t);
+    __m256 y0 = _mm256_sub_ps(yi, t);
+
+    i = _mm256_mullo_epi32(i, _mm256_set1_epi32(PRIME_X));
+    j = _mm256_mullo_epi32(j, _mm256_set1_epi32(PRIME_Y));
+    __m256i i1 = _mm256_add_epi32(i, _mm256_set1_epi32(PRIME_X));
+    __m256i j1 = _mm256_add_epi32(j, _mm256_set1_epi32(PRIME_Y));
+
+    __m256 a = _mm256_sub_ps(_mm256_sub_ps(half, _mm256_mul_ps(x0, x0)), _mm256_mul_ps(y0, y0));
+    __m256 a2 = _mm256_mul_ps(a, a);
+    __m256 n0 = _mm256_mul_ps(_mm256_mul_ps(a2, a2), grad_avx2(seeds, i, j, x0, y0, gradients));
+    n0 = _mm256_and_ps(n0, _mm256_cmp_ps(a, zero, _CMP_GT_OQ));
+
+    __m256 c = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(C_T), t), _mm256_add_ps(_mm256_set1_ps(C_A), a));
+    __m256 x2 = _mm256_add_ps(x0, _mm256_set1_ps(G2_2));
+    __m256 y2 = _mm256_add_ps(y0, _mm256_set1_ps(G2_2));
+    __m256 c2 = _mm256_mul_ps(c, c);
+    __m256 n2 = _mm256_mul_ps(_mm256_mul_ps(c2, c2), grad_avx2(seeds, i1, j1, x2, y2, gradients));
+    n2 = _mm256_and_ps(n2, _mm256_cmp_ps(c, zero, _CMP_GT_OQ));
+
+    __m256 upper = _mm256_cmp_ps(y0, x0, _CMP_GT_OQ);
+    __m256 x1 = _mm256_add_ps(x0, _mm256_blendv_ps(_mm256_set1_ps(G2_1), _mm256_set1_ps(G2), upper));
+    __m256 y1 = _mm256_add_ps(y0, _mm256_blendv_ps(_mm256_set1_ps(G2), _mm256_set1_ps(G2_1), upper));
+    __m256i x_primed = _mm256_blendv_epi8(i1, i, _mm256_castps_si256(upper));
+    __m256i y_primed = _mm256_blendv_epi8(j, j1, _mm256_castps_si256(upper));
+    __m256 b = _mm256_sub_ps(_mm256_sub_ps(half, _mm256_mul_ps(x1, x1)), _mm256_mul_ps(y1, y1));
+    __m256 b2 = _mm256_mul_ps(b, b);
+    __m256 n1 = _mm256_mul_ps(_mm256_mul_ps(b2, b2), grad_avx2(seeds, x_primed, y_primed, x1, y1, gradients));
+    n1 = _mm256_and_ps(n1, _mm256_cmp_ps(b, zero, _CMP_GT_OQ));
+
+    return _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(n0, n1), n2), _mm256_set1_ps(SIMPLEX_SCALE));
+}
+
+__attribute__((target("avx2")))
+void NoiseBatch::get_noise_grid_avx2(const FastNoiseLite& noise, float x0, float z0, float* out)
+{
+    const float* gradients = FastNoiseLite::Lookup<float>::Gradients2D;
+    bool fbm = noise.mFractalType == FastNoiseLite::FractalType_FBm;
+    int octaves = fbm ? noise.mOctaves : 1;
+    __m256 frequency = _mm256_set1_ps(noise.mFrequency);
+    __m256 lacunarity = _mm256_set1_ps(noise.mLacunarity);
+    __m256 gain = _mm256_set1_ps(noise.mGain);
+    __m256 weighted_strength = _mm256_set1_ps(noise.mWeightedStrength);
+    __m256 one = _mm256_set1_ps(1.0f);
+
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int z = 0; z < GRID_SIZE; z += 8) {
+            __m256 xs = _mm256_set1_ps(x + x0);
+            __m256 ys = _mm256_add_ps(_mm256_setr_ps(z, z + 1, z + 2, z + 3, z + 4, z + 5, z + 6, z + 7), _mm256_set1_ps(z0));
+
+            xs = _mm256_mul_ps(xs, frequency);
+            ys = _mm256_mul_ps(ys, frequency);
+            __m256 t = _mm256_mul_ps(_mm256_add_ps(xs, ys), _mm256_set1_ps(F2));
+            xs = _mm256_add_ps(xs, t);
+            ys = _mm256_add_ps(ys, t);
+
+            if (!fbm) {
+                _mm256_storeu_ps(out + x * GRID_SIZE + z, simplex_avx2(noise.mSeed, xs, ys, gradients));
+                continue;
+            }
+
+            int seed = noise.mSeed;
+            __m256 sum = _mm256_setzero_ps();
+            __m256 amp = _mm256_set1_ps(noise.mFractalBounding);
+            for (int i = 0; i < octaves; i++) {
+                __m256 value = simplex_avx2(seed++, xs, ys, gradients);
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(value, amp));
+                __m256 weight = _mm256_mul_ps(_mm256_min_ps(_mm256_add_ps(value, one), _mm256_set1_ps(2.0f)), _mm256_set1_ps(0.5f));
+                amp = _mm256_mul_ps(amp, _mm256_add_ps(one, _mm256_mul_ps(weighted_strength, _mm256_sub_ps(weight, one))));
+
+                xs = _mm256_mul_ps(xs, lacunarity);
+                ys = _mm256_mul_ps(ys, lacunarity);
+                amp = _mm256_mul_ps(amp, gain);
+            }
+            _mm256_storeu_ps(out + x * GRID_SIZE + z, sum);
+        }
+    }
+}
+
+#else
+
+void NoiseBatch::get_noise_grid_sse41(const FastNoiseLite& noise, float x0, float z0, float* out)
+{
+    get_noise_grid_scalar(noise, x0, z0, out);
+}
+
+void NoiseBatch::get_noise_grid_avx2(const FastNoiseLite& noise, float x0, float z0, float* out)
+{
+    get_noise_grid_scalar(noise, x0, z0, out);
+}
+
+#endif
+
+NoiseBatch::SimdLevel NoiseBatch::get_simd_level()
+{
+#ifdef NOISE_BATCH_X86
+    static const SimdLevel level = __builtin_cpu_supports("avx2") ? SimdLevel_AVX2 : __builtin_cpu_supports("sse4.1") ? SimdLevel_SSE41 : SimdLevel_Scalar;
+    return level;
+#else
+    return SimdLevel_Scalar;
+#endif
+}
+
+void NoiseBatch::get_noise_grid(const FastNoiseLite& noise, float x0, float z0, float* out, SimdLevel level)
+{
+    if (!is_vectorisable(noise)) {
+        level = SimdLevel_Scalar;
+    }
+
+    switch (level) {
+    case SimdLevel_AVX2:
+        get_noise_grid_avx2(noise, x0, z0, out);
+        break;
+    case SimdLevel_SSE41:
+        get_noise_grid_sse41(noise, x0, z0, out);
+        break;
+    default:
+        get_noise_grid_scalar(noise, x0, z0, out);
+        break;
+    }
+}
+
+void NoiseBatch::get_noise_grid(const FastNoiseLite& noise, float x0, float z0, float* out)
+{
+    get_noise_grid(noise, x0, z0, out, get_simd_level());
+}
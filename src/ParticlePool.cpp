@@ -0,0 +1,99 @@
+#include "ParticlePool.hpp"
+
+ParticlePool::ParticlePool(size_t capacity) : capacity(capacity)
+{
+    pos_x.resize(capacity);
+    pos_y.resize(capacity);
+    pos_z.resize(capacity);
+    vel_x.resize(capacity);
+    vel_y.resize(capacity);
+    vel_z.resize(capacity);
+    size.resize(capacity);
+    life.resize(capacity);
+    block_type.resize(capacity);
+}
+
+ParticlePool::~ParticlePool()
+{
+}
+
+bool ParticlePool::spawn(const Particle& particle)
+{
+    if (count >= capacity) {
+        return false;
+    }
+
+    pos_x[count] = particle.position.x;
+    pos_y[count] = particle.position.y;
+    pos_z[count] = particle.position.z;
+    vel_x[count] = particle.velocity.x;
+    vel_y[count] = particle.velocity.y;
+    vel_z[count] = particle.velocity.z;
+    size[count] = particle.size;
+    life[count] = particle.life;
+    block_type[count] = particle.block_type;
+    count++;
+    return true;
+}
+
+void ParticlePool::update()
+{
+    float* __restrict px = pos_x.data();
+    float* __restrict py = pos_y.data();
+    float* __restrict pz = pos_z.data();
+    float* __restrict vx = vel_x.data();
+    float* __restrict vy = vel_y.data();
+    float* __restrict vz = vel_z.data();
+    float* __restrict l = life.data();
+
+    // One loop per axis, GCC drops __restrict on locals and gives up on
+    // the alias checks of all three at once
+    for (size_t i = 0; i < count; i++) {
+        px[i] += vx[i];
+    }
+    for (size_t i = 0; i < count; i++) {
+        py[i] += vy[i];
+    }
+    for (size_t i = 0; i < count; i++) {
+        pz[i] += vz[i];
+    }
+    for (size_t i = 0; i < count; i++) {
+        vy[i] += 0.01f;
+        l[i] += 0.01f;
+    }
+
+    // Backwards so the particle swapped in has already been checked
+    for (size_t i = count; i-- > 0;) {
+        if (l[i] > 0.5f) {
+            remove(i);
+        }
+    }
+}
+
+void ParticlePool::remove(size_t index)
+{
+    size_t last = count - 1;
+    pos_x[index] = pos_x[last];
+    pos_y[index] = pos_y[last];
+    pos_z[index] = pos_z[last];
+    vel_x[index] = vel_x[last];
+    vel_y[index] = vel_y[last];
+    vel_z[index] = vel_z[last];
+    size[index] = size[last];
+    life[index] = life[last];
+    block_type[index] = block_type[last];
+    count--;
+}
+
+void ParticlePool::write_instances(ParticleInstanceData* instances, float alpha)
+{
+    // The last tick moved each particle by its velocity before gravity,
+    // particles that were never simulated have no previous position
+    float back = 1.0f - alpha;
+    for (size_t i = 0; i < count; i++) {
+        float t = life[i] > 0.0f ? back : 0.0f;
+        instances[i].pos = {pos_x[i] - vel_x[i] * t, pos_y[i] - (vel_y[i] - 0.01f) * t, pos_z[i] - vel_z[i] * t};
+        instances[i].size = size[i];
+        instances[i].block_type = block_type[i];
+    }
+}
@@ -0,0 +1,99 @@
+#include <cmath>
+#include <limits>
+
+#include "Raycast.hpp"
+
+Raycaster::Raycaster(std::vector<Chunk>& world) : world(world)
+{
+}
+
+int Raycaster::find_chunk(glm::ivec2 pos)
+{
+    if (last_index != -1 && last_pos == pos) {
+        return last_index;
+    }
+    chunk_lookups++;
+    for (size_t i = 0; i < world.size(); i++) {
+        if (glm::ivec2(world[i].pos) == pos && !world[i].should_be_deleted) {
+            last_pos = pos;
+            last_index = (int)i;
+            return last_index;
+        }
+    }
+    return -1;
+}
+
+RaycastHit Raycaster::cast(const Ray& ray)
+{
+    last_index = -1;
+    return trace(ray);
+}
+
+RaycastHit Raycaster::trace(const Ray& ray)
+{
+    RaycastHit result;
+    glm::vec3 direction = glm::normalize(ray.direction);
+    glm::ivec3 cell = glm::ivec3(glm::floor(ray.origin));
+    glm::ivec3 step(0);
+    glm::vec3 t_max(std::numeric_limits<float>::infinity());
+    glm::vec3 t_delta(std::numeric_limits<float>::infinity());
+
+    // Distance along the ray to the first boundary on each axis and between
+    // two boundaries
+    for (int axis = 0; axis < 3; axis++) {
+        if (direction[axis] > 0) {
+            step[axis] = 1;
+            t_max[axis] = (cell[axis] + 1 - ray.origin[axis]) / direction[axis];
+            t_delta[axis] = 1 / direction[axis];
+        } else if (direction[axis] < 0) {
+            step[axis] = -1;
+            t_max[axis] = (cell[axis] - ray.origin[axis]) / direction[axis];
+            t_delta[axis] = -1 / direction[axis];
+        }
+    }
+
+    glm::ivec2 chunk_pos(cell.x >> 4, cell.z >> 4);
+    int chunk_index = find_chunk(chunk_pos);
+    int previous_chunk_index = chunk_index;
+    glm::ivec3 normal(0);
+    float distance = 0.0f;
+
+    while (distance <= ray.max_distance) {
+        glm::ivec2 cell_chunk(cell.x >> 4, cell.z >> 4);
+        if (cell_chunk != chunk_pos) {
+            chunk_pos = cell_chunk;
+            chunk_index = find_chunk(chunk_pos);
+        }
+        if (chunk_index != -1 && cell.y >= 0 && cell.y < 100 && world[chunk_index].blocks[cell.x & 15][cell.y][cell.z & 15].type != 0) {
+            result.hit = true;
+            result.block = cell;
+            result.normal = normal;
+            result.adjacent = cell + normal;
+            result.distance = distance;
+            result.chunk_index = chunk_index;
+            // The adjacent cell is the one the ray came from
+            result.adjacent_chunk_index = previous_chunk_index;
+            return result;
+        }
+        previous_chunk_index = chunk_index;
+
+        int axis = t_max.x < t_max.y ? (t_max.x < t_max.z ? 0 : 2) : (t_max.y < t_max.z ? 1 : 2);
+        distance = t_max[axis];
+        t_max[axis] += t_delta[axis];
+        cell[axis] += step[axis];
+        normal = glm::ivec3(0);
+        normal[axis] = -step[axis];
+    }
+    return result;
+}
+
+std::vector<RaycastHit> Raycaster::cast_batch(const std::vector<Ray>& rays)
+{
+    std::vector<RaycastHit> hits;
+    hits.reserve(rays.size());
+    last_index = -1;
+    for (const Ray& ray : rays) {
+        hits.push_back(trace(ray));
+    }
+    return hits;
+}
@@ -0,0 +1,58 @@
+#include "RegionEditor.hpp"
+
+size_t RegionEditor::fill(glm::ivec3 min, glm::ivec3 max, uint16_t type)
+{
+    return edit(min, max, [type](glm::ivec3, uint16_t) { return type; });
+}
+
+size_t RegionEditor::replace(glm::ivec3 min, glm::ivec3 max, uint16_t from, uint16_t to)
+{
+    return edit(min, max, [from, to](glm::ivec3, uint16_t current) { return current == from ? to : current; });
+}
+
+size_t RegionEditor::sphere(glm::ivec3 min, glm::ivec3 max, uint16_t type)
+{
+    // Twice the coordinates keeps the block centers on integers
+    glm::ivec3 center = min + max;
+    glm::ivec3 size = glm::abs(max - min) + 1;
+    int radius = std::min(size.x, std::min(size.y, size.z));
+    int radius_squared = radius * radius;
+    return edit(min, max, [=](glm::ivec3 pos, uint16_t current) {
+        glm::ivec3 offset = pos * 2 - center;
+        return offset.x * offset.x + offset.y * offset.y + offset.z * offset.z <= radius_squared ? type : current;
+    });
+}
+
+BlockRegion RegionEditor::copy(glm::ivec3 min, glm::ivec3 max) const
+{
+    glm::ivec3 first = glm::min(min, max);
+    BlockRegion region;
+    region.size = glm::abs(max - min) + 1;
+    region.types.assign((size_t)region.size.x * region.size.y * region.size.z, 0);
+
+    for (int x = 0; x < region.size.x; x++) {
+        for (int z = 0; z < region.size.z; z++) {
+            glm::ivec3 column = first + glm::ivec3(x, 0, z);
+            Chunk* chunk = chunks.find(glm::ivec2(column.x >> 4, column.z >> 4));
+            if (!chunk) {
+                continue;
+            }
+            for (int y = std::max(0, -first.y); y < region.size.y && first.y + y < 100; y++) {
+                region.types[((size_t)x * region.size.y + y) * region.size.z + z] = chunk->blocks[column.x & 15][first.y + y][column.z & 15].type;
+            }
+        }
+    }
+    return region;
+}
+
+size_t RegionEditor::paste(const BlockRegion& region, glm::ivec3 origin, bool include_air)
+{
+    if (region.types.empty()) {
+        return 0;
+    }
+    return edit(origin, origin + region.size - 1, [&](glm::ivec3 pos, uint16_t current) {
+        glm::ivec3 offset = pos - origin;
+        uint16_t type = region.types[((size_t)offset.x * region.size.y + offset.y) * region.size.z + offset.z];
+        return type != 0 || include_air ? type : current;
+    });
+}
@@ -0,0 +1,172 @@
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "RegionFile.hpp"
+
+RegionFile::RegionFile(const std::string& path) : path(path)
+{
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open region file " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        throw std::runtime_error("Could not stat region file " + path);
+    }
+    size_t file_size = info.st_size;
+    if (file_size < TABLE_SECTORS * SECTOR_SIZE) {
+        std::vector<uint8_t> header(TABLE_SECTORS * SECTOR_SIZE, 0);
+        if (pwrite(fd, header.data(), header.size(), 0) != (ssize_t)header.size()) {
+            throw std::runtime_error("Could not write region file " + path);
+        }
+        file_size = header.size();
+    }
+    if (pread(fd, table.data(), sizeof(table), 0) != (ssize_t)sizeof(table)) {
+        throw std::runtime_error("Could not read region file " + path);
+    }
+
+    used_sectors.assign((file_size + SECTOR_SIZE - 1) / SECTOR_SIZE, false);
+    for (size_t i = 0; i < TABLE_SECTORS; i++) {
+        used_sectors[i] = true;
+    }
+    for (uint32_t& entry : table) {
+        uint32_t first = entry >> 8;
+        uint32_t count = entry & 0xff;
+        // Entries pointing past the end are from a write that didn't finish
+        if (first < TABLE_SECTORS || first + count > used_sectors.size()) {
+            entry = 0;
+            continue;
+        }
+        for (uint32_t i = first; i < first + count; i++) {
+            used_sectors[i] = true;
+        }
+    }
+    disk_table = table;
+}
+
+RegionFile::~RegionFile()
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+glm::ivec2 RegionFile::get_region(glm::ivec2 chunk_pos)
+{
+    // Arithmetic shift, floors negative positions
+    return glm::ivec2(chunk_pos.x >> 5, chunk_pos.y >> 5);
+}
+
+int RegionFile::get_index(glm::ivec2 chunk_pos)
+{
+    return (chunk_pos.x & (REGION_SIZE - 1)) * REGION_SIZE + (chunk_pos.y & (REGION_SIZE - 1));
+}
+
+void RegionFile::make_record(const std::vector<uint8_t>& data, uint8_t compression, size_t sectors, std::vector<uint8_t>& record)
+{
+    uint32_t length = data.size() + 1;
+    record.assign(sectors * SECTOR_SIZE, 0);
+    memcpy(record.data(), &length, 4);
+    record[4] = compression;
+    memcpy(record.data() + 5, data.data(), data.size());
+}
+
+bool RegionFile::parse_record(const std::vector<uint8_t>& record, std::vector<uint8_t>& data, uint8_t& compression)
+{
+    uint32_t length;
+    if (record.size() < 5) {
+        return false;
+    }
+    memcpy(&length, record.data(), 4);
+    if (length < 1 || length + 4 > record.size()) {
+        return false;
+    }
+    compression = record[4];
+    data.assign(record.begin() + 5, record.begin() + 4 + length);
+    return true;
+}
+
+bool RegionFile::locate(glm::ivec2 chunk_pos, uint64_t& offset, size_t& size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t entry = table[get_index(chunk_pos)];
+    if (entry == 0) {
+        return false;
+    }
+    offset = (uint64_t)(entry >> 8) * SECTOR_SIZE;
+    size = (size_t)(entry & 0xff) * SECTOR_SIZE;
+    return true;
+}
+
+uint32_t RegionFile::allocate(glm::ivec2 chunk_pos, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = (size + 5 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    if (count > 255) {
+        throw std::runtime_error("Chunk too big for region file " + path);
+    }
+
+    // First free run that fits, the sectors of the table entry on disk and
+    // of records still being written are kept
+    size_t first = TABLE_SECTORS;
+    size_t run = 0;
+    for (size_t i = TABLE_SECTORS; i < used_sectors.size() && run < count; i++) {
+        if (used_sectors[i]) {
+            run = 0;
+            first = i + 1;
+        } else {
+            run++;
+        }
+    }
+    if (run < count) {
+        first = used_sectors.size() - run;
+        used_sectors.resize(first + count, false);
+    }
+    for (size_t i = first; i < first + count; i++) {
+        used_sectors[i] = true;
+    }
+
+    // Reads find the new place right away, the saved chunk stays pending
+    // in ChunkStorage until its record is on disk
+    int index = get_index(chunk_pos);
+    table[index] = (uint32_t)(first << 8 | count);
+    return table[index];
+}
+
+void RegionFile::free_sectors(uint32_t entry)
+{
+    for (uint32_t i = entry >> 8; i < (entry >> 8) + (entry & 0xff); i++) {
+        used_sectors[i] = false;
+    }
+}
+
+bool RegionFile::record_written(glm::ivec2 chunk_pos, uint32_t entry, bool ok)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    int index = get_index(chunk_pos);
+    if (ok && table[index] == entry) {
+        return true;
+    }
+    // A newer save of the chunk writes its own entry, a failed one leaves
+    // the chunk where the table on disk has it
+    if (table[index] == entry) {
+        table[index] = disk_table[index];
+    }
+    free_sectors(entry);
+    return false;
+}
+
+void RegionFile::entry_written(glm::ivec2 chunk_pos, uint32_t entry)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    int index = get_index(chunk_pos);
+    if (disk_table[index] != entry) {
+        free_sectors(disk_table[index]);
+        disk_table[index] = entry;
+    }
+}
@@ -0,0 +1,125 @@
+#include <algorithm>
+
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+    if (thread_count == 0) {
+        // hardware_concurrency is 0 when it can't tell
+        unsigned cores = std::thread::hardware_concurrency();
+        thread_count = cores > 1 ? cores - 1 : 1;
+    }
+    for (size_t i = 0; i < thread_count; i++) {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        tasks.clear();
+    }
+    condition.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+bool ThreadPool::earlier_first(const Task& a, const Task& b)
+{
+    // std::push_heap keeps the largest element on top
+    if (a.priority != b.priority) {
+        return a.priority > b.priority;
+    }
+    return a.sequence > b.sequence;
+}
+
+void ThreadPool::submit(std::function<void()> task, int priority)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back({priority, next_sequence++, std::move(task)});
+        std::push_heap(tasks.begin(), tasks.end(), earlier_first);
+    }
+    condition.notify_one();
+}
+
+size_t ThreadPool::get_pending_tasks()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return tasks.size();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle_condition.wait(lock, [this] { return tasks.empty() && running == 0; });
+}
+
+void ThreadPool::run_batches(size_t count, const std::function<void(size_t)>& batch, int priority)
+{
+    struct Batches
+    {
+        std::function<void(size_t)> run;
+        size_t count;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto batches = std::make_shared<Batches>();
+    batches->run = batch;
+    batches->count = count;
+
+    // Workers still busy with longer tasks when the batches run out find
+    // nothing left, the caller never waits on more than the batches taken
+    auto work = [batches]() {
+        for (size_t i = batches->next++; i < batches->count; i = batches->next++) {
+            batches->run(i);
+            if (++batches->done == batches->count) {
+                std::lock_guard<std::mutex> lock(batches->mutex);
+                batches->finished.notify_all();
+            }
+        }
+    };
+    for (size_t i = 1; i < std::min(count, workers.size() + 1); i++) {
+        submit(work, priority);
+    }
+    work();
+
+    std::unique_lock<std::mutex> lock(batches->mutex);
+    batches->finished.wait(lock, [&batches] { return batches->done == batches->count; });
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping) {
+                return;
+            }
+            std::pop_heap(tasks.begin(), tasks.end(), earlier_first);
+            task = std::move(tasks.back().run);
+            tasks.pop_back();
+            running++;
+        }
+        task();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+        }
+        idle_condition.notify_all();
+    }
+}
@@ -2,6 +2,7 @@
 #include <stdexcept>
 #include <chrono>
 #include <algorithm>
+#include <cmath>
 
 #include <vulkan/vulkan.h>
 
@@ -86,9 +87,7 @@ void VkEngine::create_swapchain()
 {
     vkb::SwapchainBuilder swapchain_builder{device};
     auto swapchain_ret = swapchain_builder.use_default_format_selection()
-                            .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-                            // To remove VSYNC, uncomment the line below and comment the line above
-                            //.set_desired_present_mode(VK_PRESENT_MODE_IMMEDIATE_KHR)
+                            .set_desired_present_mode(vsync ? VK_PRESENT_MODE_FIFO_KHR : VK_PRESENT_MODE_IMMEDIATE_KHR)
                             .set_desired_extent(width, height)
                             .set_image_usage_flags(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
                             .build();
@@ -198,10 +197,35 @@ void VkEngine::create_framebuffers()
 
 void VkEngine::create_all_graphics_pipelines()
 {
-    create_graphics_pipeline(vk_graphics_pipeline, vk_pipeline_layout, "shaders/blocks_vert.spv", "shaders/blocks_frag.spv");
+    // The block pipelines bind the same descriptor sets through one layout
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &vk_descriptor_set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 0;
+    pipeline_layout_info.pPushConstantRanges = nullptr;
+
+    if (vkCreatePipelineLayout(device.device, &pipeline_layout_info, nullptr, &vk_pipeline_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Could not create pipeline layout");
+    }
+
+    // Translucent faces are blended rather than discarded, like opaque ones
+    create_graphics_pipeline(vk_graphics_pipeline, vk_pipeline_layout, BUCKET_OPAQUE, "shaders/blocks_vert.spv", "shaders/blocks_opaque_frag.spv");
+    create_graphics_pipeline(vk_cutout_graphics_pipeline, vk_pipeline_layout, BUCKET_CUTOUT, "shaders/blocks_vert.spv", "shaders/blocks_frag.spv");
+    create_graphics_pipeline(vk_translucent_graphics_pipeline, vk_pipeline_layout, BUCKET_TRANSLUCENT, "shaders/blocks_vert.spv", "shaders/blocks_opaque_frag.spv");
     create_graphics_pipeline_particles(vk_particles_graphics_pipeline, vk_particles_pipeline_layout, "shaders/particles_vert.spv", "shaders/particles_frag.spv");
 }
 
+void VkEngine::destroy_all_graphics_pipelines()
+{
+    vkDestroyPipeline(device.device, vk_graphics_pipeline, nullptr);
+    vkDestroyPipelineLayout(device.device, vk_pipeline_layout, nullptr);
+    vkDestroyPipeline(device.device, vk_cutout_graphics_pipeline, nullptr);
+    vkDestroyPipeline(device.device, vk_translucent_graphics_pipeline, nullptr);
+    vkDestroyPipeline(device.device, vk_particles_graphics_pipeline, nullptr);
+    vkDestroyPipelineLayout(device.device, vk_particles_pipeline_layout, nullptr);
+}
+
 void VkEngine::create_graphics_pipeline_particles(VkPipeline& pipeline, VkPipelineLayout& pipeline_layout, const char* vert_path, const char* frag_path, const char* geom_path)
 {
     auto vert_shader_code = read_file(vert_path);
@@ -363,7 +387,7 @@ void VkEngine::create_graphics_pipeline_particles(VkPipeline& pipeline, VkPipeli
     }
 }
 
-void VkEngine::create_graphics_pipeline(VkPipeline& pipeline, VkPipelineLayout& pipeline_layout, const char* vert_path, const char* frag_path, const char* geom_path)
+void VkEngine::create_graphics_pipeline(VkPipeline& pipeline, VkPipelineLayout pipeline_layout, BlockBucket bucket, const char* vert_path, const char* frag_path, const char* geom_path)
 {
     auto vert_shader_code = read_file(vert_path);
     auto frag_shader_code = read_file(frag_path);
@@ -446,7 +470,8 @@ void VkEngine::create_graphics_pipeline(VkPipeline& pipeline, VkPipelineLayout&
 
     VkPipelineColorBlendAttachmentState color_blend_attachment = {};
     color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    color_blend_attachment.blendEnable = VK_TRUE;
+    // Only translucent faces need blending, opaque and cutout ones keep early depth testing
+    color_blend_attachment.blendEnable = (bucket == BUCKET_TRANSLUCENT) ? VK_TRUE : VK_FALSE;
     color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
     color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
     color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
@@ -465,17 +490,6 @@ void VkEngine::create_graphics_pipeline(VkPipeline& pipeline, VkPipelineLayout&
     color_blending.blendConstants[2] = 0.0f;
     color_blending.blendConstants[3] = 0.0f;
     
-    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
-    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_info.setLayoutCount = 1;
-    pipeline_layout_info.pSetLayouts = &vk_descriptor_set_layout;
-    pipeline_layout_info.pushConstantRangeCount = 0;
-    pipeline_layout_info.pPushConstantRanges = nullptr;
-    
-    if (vkCreatePipelineLayout(device.device, &pipeline_layout_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
-        throw std::runtime_error("Could not create pipeline layout");
-    }
-    
     std::vector<VkDynamicState> dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
     VkPipelineDynamicStateCreateInfo dynamic_state_info = {};
     dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
@@ -485,7 +499,7 @@ void VkEngine::create_graphics_pipeline(VkPipeline& pipeline, VkPipelineLayout&
     VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
     depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
     depth_stencil.depthTestEnable = VK_TRUE;
-    depth_stencil.depthWriteEnable = VK_TRUE;
+    depth_stencil.depthWriteEnable = (bucket == BUCKET_TRANSLUCENT) ? VK_FALSE : VK_TRUE;
     depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
     depth_stencil.depthBoundsTestEnable = VK_FALSE;
     depth_stencil.minDepthBounds = 0.0f;
@@ -506,7 +520,7 @@ void VkEngine::create_graphics_pipeline(VkPipeline& pipeline, VkPipelineLayout&
     pipeline_info.pColorBlendState = &color_blending;
     pipeline_info.pDynamicState = &dynamic_state_info;
     pipeline_info.pDepthStencilState = &depth_stencil;
-    pipeline_info.layout = vk_pipeline_layout;
+    pipeline_info.layout = pipeline_layout;
     pipeline_info.renderPass = vk_render_pass;
     pipeline_info.subpass = 0;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
@@ -573,12 +587,13 @@ void VkEngine::record_command_buffer(VkCommandBuffer command_buffer, uint32_t im
     render_pass_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
     render_pass_info.pClearValues = clear_values.data();
 
-    
+    if (vk_particles_vertex_buffer != VK_NULL_HANDLE) {
+        record_particles_compute(command_buffer);
+    }
+    record_translucent_sorts(command_buffer, world);
 
     vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
 
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_graphics_pipeline);
-
     VkViewport viewport = {};
     viewport.width = (float) swapchain.extent.width;
     viewport.height = (float) swapchain.extent.height;
@@ -599,14 +614,18 @@ void VkEngine::record_command_buffer(VkCommandBuffer command_buffer, uint32_t im
     // vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout, 0, 1, &vk_descriptor_sets[current_frame], 0, nullptr);
     // vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
 
+    std::array<VkPipeline, BUCKET_COUNT> bucket_pipelines = {vk_graphics_pipeline, vk_cutout_graphics_pipeline, vk_translucent_graphics_pipeline};
+    bool hide_chunks = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+
     vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout, 0, 1, &vk_descriptor_sets_chunks[current_frame], 0, nullptr);
-    for (auto& chunk : world) {
-        if (chunk.should_be_deleted || glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
-            continue;
+    for (int bucket = BUCKET_OPAQUE; bucket < BUCKET_TRANSLUCENT; bucket++) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bucket_pipelines[bucket]);
+        for (auto& chunk : world) {
+            if (chunk.should_be_deleted || hide_chunks) {
+                continue;
+            }
+            draw_chunk_mesh(command_buffer, chunk.meshes[bucket]);
         }
-        vkCmdBindVertexBuffers(command_buffer, 0, 1, &chunk.vk_vertex_buffer, offsets);
-        vkCmdBindIndexBuffer(command_buffer, chunk.vk_index_buffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(chunk.indices.size()), 1, 0, 0, 0);
     }
 
     if (vk_particles_vertex_buffer != VK_NULL_HANDLE) {
@@ -621,7 +640,12 @@ void VkEngine::record_command_buffer(VkCommandBuffer command_buffer, uint32_t im
 
         vkCmdBindVertexBuffers(command_buffer, 1, 1, &vk_particles_instance_buffer, offsets);
 
-        vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(particles_indices.size()), static_cast<uint32_t>(particles.size()), 0, 0, 0);
+        vkCmdDrawIndexedIndirect(command_buffer, vk_particles_indirect_buffer, current_frame * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+
+        if (particle_pool.count > 0) {
+            vkCmdBindVertexBuffers(command_buffer, 1, 1, &vk_particles_cpu_instance_buffers[current_frame], offsets);
+            vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(particles_indices.size()), static_cast<uint32_t>(particle_pool.count), 0, 0, 0);
+        }
         //vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(particles_indices.size()), 1, 0, 0, 0);
         // int i = 0;
         // for (auto& particle : particles) {
@@ -632,6 +656,25 @@ void VkEngine::record_command_buffer(VkCommandBuffer command_buffer, uint32_t im
         // memcpy(vk_uniform_buffers_mapped[current_frame], &old_ubo, sizeof(old_ubo));
     }
 
+    // Translucent faces go last, chunks from back to front
+    std::vector<Chunk*> translucent_chunks;
+    for (auto& chunk : world) {
+        if (!chunk.should_be_deleted && !hide_chunks && !chunk.meshes[BUCKET_TRANSLUCENT].indices.empty()) {
+            translucent_chunks.push_back(&chunk);
+        }
+    }
+    glm::vec2 camera_pos = glm::vec2(player.camera.pos.x, player.camera.pos.z);
+    std::sort(translucent_chunks.begin(), translucent_chunks.end(), [&camera_pos](Chunk* a, Chunk* b) {
+        glm::vec2 da = a->pos * 16.0f + 8.0f - camera_pos;
+        glm::vec2 db = b->pos * 16.0f + 8.0f - camera_pos;
+        return glm::dot(da, da) > glm::dot(db, db);
+    });
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_translucent_graphics_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout, 0, 1, &vk_descriptor_sets_chunks[current_frame], 0, nullptr);
+    for (auto chunk : translucent_chunks) {
+        draw_chunk_mesh(command_buffer, chunk->meshes[BUCKET_TRANSLUCENT]);
+    }
+
     //Render GUI
     ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), vk_command_buffers_blocks[current_frame]);
 
@@ -642,6 +685,17 @@ void VkEngine::record_command_buffer(VkCommandBuffer command_buffer, uint32_t im
     }
 }
 
+void VkEngine::draw_chunk_mesh(VkCommandBuffer command_buffer, ChunkMesh& mesh)
+{
+    if (mesh.indices.empty() || mesh.vk_index_buffer == VK_NULL_HANDLE) {
+        return;
+    }
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &mesh.vk_vertex_buffer, offsets);
+    vkCmdBindIndexBuffer(command_buffer, mesh.vk_index_buffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(mesh.indices.size()), 1, 0, 0, 0);
+}
+
 void VkEngine::create_sync_objects()
 {
     vk_image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
@@ -671,8 +725,7 @@ void VkEngine::recreate_swapchain()
 
     vkDestroyCommandPool(device.device, vk_command_pool, nullptr);
 
-    vkDestroyPipeline(device.device, vk_graphics_pipeline, nullptr);
-    vkDestroyPipelineLayout(device.device, vk_pipeline_layout, nullptr);
+    destroy_all_graphics_pipelines();
 
     vkDestroyRenderPass(device.device, vk_render_pass, nullptr);
     for (auto framebuffer : vk_framebuffers) {
@@ -688,12 +741,18 @@ void VkEngine::recreate_swapchain()
     get_queues();
     create_render_pass();
     create_framebuffers();
-    create_graphics_pipeline(vk_graphics_pipeline, vk_pipeline_layout, "shaders/blocks_vert.spv", "shaders/blocks_frag.spv");
-    create_graphics_pipeline(vk_particles_graphics_pipeline, vk_particles_pipeline_layout, "shaders/particles_vert.spv", "shaders/particles_frag.spv");
+    create_all_graphics_pipelines();
     create_command_pool();
     create_command_buffers();
 }
 
+void VkEngine::set_vsync(bool enabled)
+{
+    // The swapchain is rebuilt with the new present mode after the next frame
+    vsync = enabled;
+    framebuffer_resized = true;
+}
+
 void VkEngine::draw_frame(Player& player, std::vector<Chunk>& world)
 {
     vkWaitForFences(device.device, 1, &vk_in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
@@ -702,12 +761,9 @@ void VkEngine::draw_frame(Player& player, std::vector<Chunk>& world)
     for (auto& chunk : world) {
         if (chunk.should_be_deleted && p < world.size() - 1) {
             vkWaitForFences(device.device, MAX_FRAMES_IN_FLIGHT, vk_in_flight_fences.data(), VK_TRUE, UINT64_MAX);
-            vkDestroyBuffer(device.device, chunk.vk_vertex_buffer, nullptr);
-            vkFreeMemory(device.device, chunk.vk_vertex_buffer_memory, nullptr);
-            vkDestroyBuffer(device.device, chunk.vk_index_buffer, nullptr);
-            vkFreeMemory(device.device, chunk.vk_index_buffer_memory, nullptr);
+            destroy_buffers_chunk(chunk);
             if (&chunk != &world.back()) {
-                chunk = world.back();
+                chunk = std::move(world.back());
             }
             world.pop_back();
         }
@@ -730,7 +786,10 @@ void VkEngine::draw_frame(Player& player, std::vector<Chunk>& world)
 
     vkResetCommandBuffer(vk_command_buffers_blocks[current_frame], 0);
 
+    update_particles();
+
     record_command_buffer(vk_command_buffers_blocks[current_frame], image_index, world, player);
+    particle_ticks = 0;
 
     VkSubmitInfo submit_info = {};
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -989,14 +1048,8 @@ void VkEngine::update_uniform_buffer(uint32_t current_image, Camera& camera)
 
     memcpy(vk_uniform_buffers_mapped[current_image], &ubo, sizeof(ubo));
 
-    if (vk_particles_vertex_buffer == VK_NULL_HANDLE || particles.size() <= 0) {
-        return;
-    }
-
     UniformBufferObject ubo_particle = {};
     ubo_particle.model = glm::mat4(1.0f);
-    ubo_particle.model = glm::translate(glm::mat4(1.0f), particles[0].position);
-    ubo_particle.model = glm::translate(ubo_particle.model, particles[0].offset);
     ubo_particle.view = glm::lookAt(camera.pos, camera.pos + camera.front, camera.up);
     ubo_particle.proj = glm::perspective(camera.fov, swapchain.extent.width / (float) swapchain.extent.height, 0.1f, 800.0f);
     ubo_particle.proj[1][1] *= -1;
@@ -1129,22 +1182,27 @@ void VkEngine::create_descriptor_sets()
     }
 }
 
-void VkEngine::add_cube_to_vertices(Cube& cube, int up, int down, int left, int right, int front, int back, glm::vec2 chunk_pos, Chunk& chunk)
+void VkEngine::add_cube_to_vertices(Cube& cube, int up, int down, int left, int right, int front, int back, glm::vec2 chunk_pos, Chunk& chunk, int scale)
 {
     //std::cout << cube.pos.x << " " << cube.pos.y << " " << cube.pos.z << std::endl;
-    float tex_x = fmodf((cube.type - 1), 16.0f) / 16.0f;
-    float tex_y = floor((cube.type - 1) / 16.0f) / 16.0f;
-    std::vector<std::array<float, 2>> texture_coords = {
-        {tex_x, tex_y},
-        {tex_x, tex_y},
-        {tex_x, tex_y},
-        {tex_x, tex_y},
-        {tex_x, tex_y},
-        {tex_x, tex_y}
+    // Texture array layer of each face, UVs repeat once per block
+    float layer = cube.type - 1;
+    std::array<float, 6> layers = {layer, layer, layer, layer, layer, layer};
+
+    float size = (float)scale;
+    ChunkMesh& mesh = chunk.meshes[block_buckets[cube.type]];
+
+    // Light of the block in front of each face, in the order of the faces below
+    glm::ivec3 p = cube.pos;
+    std::array<uint8_t, 6> lights = {
+        chunk.get_face_light(p.x, p.y, p.z - 1),
+        chunk.get_face_light(p.x, p.y, p.z + scale),
+        chunk.get_face_light(p.x, p.y - 1, p.z),
+        chunk.get_face_light(p.x, p.y + scale, p.z),
+        chunk.get_face_light(p.x + scale, p.y, p.z),
+        chunk.get_face_light(p.x - 1, p.y, p.z)
     };
 
-    float offset = 1.0f / 16.0f;
-
     cube.pos.x += chunk_pos.x * 16;
     cube.pos.z += chunk_pos.y * 16;
 
@@ -1159,16 +1217,16 @@ void VkEngine::add_cube_to_vertices(Cube& cube, int up, int down, int left, int
 
     if (cube.type == 1) {
         colors[2] = {0.3f, 0.9f, 0.1f};
-        texture_coords[0] = {fmodf((4 - 1), 16.0f) / 16.0f, floor((4 - 1) / 16.0f) / 16.0f};
-        texture_coords[1] = {fmodf((4 - 1), 16.0f) / 16.0f, floor((4 - 1) / 16.0f) / 16.0f};
-        //texture_coords[2] = {fmodf((4 - 1), 16.0f) / 16.0f, floor((4 - 1) / 16.0f) / 16.0f};
-        texture_coords[3] = {fmodf((3 - 1), 16.0f) / 16.0f, floor((3 - 1) / 16.0f) / 16.0f};
-        texture_coords[4] = {fmodf((4 - 1), 16.0f) / 16.0f, floor((4 - 1) / 16.0f) / 16.0f};
-        texture_coords[5] = {fmodf((4 - 1), 16.0f) / 16.0f, floor((4 - 1) / 16.0f) / 16.0f};
+        layers[0] = 4 - 1;
+        layers[1] = 4 - 1;
+        //layers[2] = 4 - 1;
+        layers[3] = 3 - 1;
+        layers[4] = 4 - 1;
+        layers[5] = 4 - 1;
     }
     if (cube.type == 21) {
-        texture_coords[2] = {fmodf((22 - 1), 16.0f) / 16.0f, floor((22 - 1) / 16.0f) / 16.0f};
-        texture_coords[3] = {fmodf((22 - 1), 16.0f) / 16.0f, floor((22 - 1) / 16.0f) / 16.0f};
+        layers[2] = 22 - 1;
+        layers[3] = 22 - 1;
     }
     if (cube.type == 53 || cube.type == 54) {
         colors[0] = {0.25f, 0.95f, 0.05f};
@@ -1178,108 +1236,111 @@ void VkEngine::add_cube_to_vertices(Cube& cube, int up, int down, int left, int
         colors[4] = {0.25f, 0.95f, 0.05f};
         colors[5] = {0.25f, 0.95f, 0.05f};
     }
+    for (int face = 0; face < 6; face++) {
+        colors[face] *= get_light_brightness(lights[face]);
+    }
 
     int i = 0;
 
     //back good
-    if (front == 0) {
-        chunk.vertices.push_back({{cube.pos.x, cube.pos.y, cube.pos.z}, colors[i], {texture_coords[i][0], texture_coords[i][1]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x + 1.0f, cube.pos.y, cube.pos.z}, colors[i], {texture_coords[i][0] + offset, texture_coords[i][1]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x + 1.0f, cube.pos.y + 1.0f, cube.pos.z}, colors[i], {texture_coords[i][0] + offset, texture_coords[i][1] + offset}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x, cube.pos.y + 1.0f, cube.pos.z}, colors[i], {texture_coords[i][0], texture_coords[i][1] + offset}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-
-        size_t len = chunk.vertices.size();
-        chunk.indices.push_back(len - 4);
-        chunk.indices.push_back(len - 1);
-        chunk.indices.push_back(len - 2);
-        chunk.indices.push_back(len - 2);
-        chunk.indices.push_back(len - 3);
-        chunk.indices.push_back(len - 4);
+    if (is_face_visible(cube.type, front)) {
+        mesh.vertices.push_back({{cube.pos.x, cube.pos.y, cube.pos.z}, colors[i], {0.0f, 0.0f, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x + size, cube.pos.y, cube.pos.z}, colors[i], {size, 0.0f, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x + size, cube.pos.y + size, cube.pos.z}, colors[i], {size, size, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x, cube.pos.y + size, cube.pos.z}, colors[i], {0.0f, size, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+
+        size_t len = mesh.vertices.size();
+        mesh.indices.push_back(len - 4);
+        mesh.indices.push_back(len - 1);
+        mesh.indices.push_back(len - 2);
+        mesh.indices.push_back(len - 2);
+        mesh.indices.push_back(len - 3);
+        mesh.indices.push_back(len - 4);
         cube.faces += 1;
     }
     i++;
     //front good
-    if (back == 0) {
-        chunk.vertices.push_back({{cube.pos.x, cube.pos.y, cube.pos.z + 1.0f}, colors[i], {texture_coords[i][0] + offset, texture_coords[i][1]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x + 1.0f, cube.pos.y, cube.pos.z + 1.0f}, colors[i], {texture_coords[i][0], texture_coords[i][1]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x + 1.0f, cube.pos.y + 1.0f, cube.pos.z + 1.0f}, colors[i], {texture_coords[i][0], texture_coords[i][1] + offset}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x, cube.pos.y + 1.0f, cube.pos.z + 1.0f}, colors[i], {texture_coords[i][0] + offset, texture_coords[i][1] + offset}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-
-        size_t len = chunk.vertices.size();
-        chunk.indices.push_back(len - 4);
-        chunk.indices.push_back(len - 3);
-        chunk.indices.push_back(len - 2);
-        chunk.indices.push_back(len - 2);
-        chunk.indices.push_back(len - 1);
-        chunk.indices.push_back(len - 4);
+    if (is_face_visible(cube.type, back)) {
+        mesh.vertices.push_back({{cube.pos.x, cube.pos.y, cube.pos.z + size}, colors[i], {size, 0.0f, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x + size, cube.pos.y, cube.pos.z + size}, colors[i], {0.0f, 0.0f, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x + size, cube.pos.y + size, cube.pos.z + size}, colors[i], {0.0f, size, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x, cube.pos.y + size, cube.pos.z + size}, colors[i], {size, size, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+
+        size_t len = mesh.vertices.size();
+        mesh.indices.push_back(len - 4);
+        mesh.indices.push_back(len - 3);
+        mesh.indices.push_back(len - 2);
+        mesh.indices.push_back(len - 2);
+        mesh.indices.push_back(len - 1);
+        mesh.indices.push_back(len - 4);
         cube.faces += 1;
     }
     i++;
     //up good
-    if (up == 0) {
-        chunk.vertices.push_back({{cube.pos.x, cube.pos.y, cube.pos.z}, colors[i], {texture_coords[i][0], texture_coords[i][1]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x + 1.0f, cube.pos.y, cube.pos.z}, colors[i], {texture_coords[i][0] + offset, texture_coords[i][1]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x + 1.0f, cube.pos.y, cube.pos.z + 1.0f}, colors[i], {texture_coords[i][0] + offset, texture_coords[i][1] + offset}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x, cube.pos.y, cube.pos.z + 1.0f}, colors[i], {texture_coords[i][0], texture_coords[i][1] + offset}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-
-        size_t len = chunk.vertices.size();
-        chunk.indices.push_back(len - 4);
-        chunk.indices.push_back(len - 3);
-        chunk.indices.push_back(len - 2);
-        chunk.indices.push_back(len - 2);
-        chunk.indices.push_back(len - 1);
-        chunk.indices.push_back(len - 4);
+    if (is_face_visible(cube.type, up)) {
+        mesh.vertices.push_back({{cube.pos.x, cube.pos.y, cube.pos.z}, colors[i], {0.0f, 0.0f, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x + size, cube.pos.y, cube.pos.z}, colors[i], {size, 0.0f, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x + size, cube.pos.y, cube.pos.z + size}, colors[i], {size, size, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x, cube.pos.y, cube.pos.z + size}, colors[i], {0.0f, size, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+
+        size_t len = mesh.vertices.size();
+        mesh.indices.push_back(len - 4);
+        mesh.indices.push_back(len - 3);
+        mesh.indices.push_back(len - 2);
+        mesh.indices.push_back(len - 2);
+        mesh.indices.push_back(len - 1);
+        mesh.indices.push_back(len - 4);
         cube.faces += 1;
     }
     i++;
     //down good
-    if (down == 0) {
-        chunk.vertices.push_back({{cube.pos.x, cube.pos.y + 1.0f, cube.pos.z}, colors[i], {texture_coords[i][0], texture_coords[i][1]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x + 1.0f, cube.pos.y + 1.0f, cube.pos.z}, colors[i], {texture_coords[i][0] + offset, texture_coords[i][1]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x + 1.0f, cube.pos.y + 1.0f, cube.pos.z + 1.0f}, colors[i], {texture_coords[i][0] + offset, texture_coords[i][1] + offset}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x, cube.pos.y + 1.0f, cube.pos.z + 1.0f}, colors[i], {texture_coords[i][0], texture_coords[i][1] + offset}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-
-        size_t len = chunk.vertices.size();
-        chunk.indices.push_back(len - 4);
-        chunk.indices.push_back(len - 1);
-        chunk.indices.push_back(len - 2);
-        chunk.indices.push_back(len - 2);
-        chunk.indices.push_back(len - 3);
-        chunk.indices.push_back(len - 4);
+    if (is_face_visible(cube.type, down)) {
+        mesh.vertices.push_back({{cube.pos.x, cube.pos.y + size, cube.pos.z}, colors[i], {0.0f, 0.0f, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x + size, cube.pos.y + size, cube.pos.z}, colors[i], {size, 0.0f, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x + size, cube.pos.y + size, cube.pos.z + size}, colors[i], {size, size, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x, cube.pos.y + size, cube.pos.z + size}, colors[i], {0.0f, size, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+
+        size_t len = mesh.vertices.size();
+        mesh.indices.push_back(len - 4);
+        mesh.indices.push_back(len - 1);
+        mesh.indices.push_back(len - 2);
+        mesh.indices.push_back(len - 2);
+        mesh.indices.push_back(len - 3);
+        mesh.indices.push_back(len - 4);
         cube.faces += 1;
     }
     i++;
     //left
-    if (right == 0) {
-        chunk.vertices.push_back({{cube.pos.x + 1.0f, cube.pos.y, cube.pos.z}, colors[i], {texture_coords[i][0], texture_coords[i][1]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x + 1.0f, cube.pos.y + 1.0f, cube.pos.z}, colors[i], {texture_coords[i][0], texture_coords[i][1]  + offset}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x + 1.0f, cube.pos.y + 1.0f, cube.pos.z + 1.0f}, colors[i], {texture_coords[i][0] + offset, texture_coords[i][1] + offset}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x + 1.0f, cube.pos.y, cube.pos.z + 1.0f}, colors[i], {texture_coords[i][0] + offset, texture_coords[i][1]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-
-        size_t len = chunk.vertices.size();
-        chunk.indices.push_back(len - 4);
-        chunk.indices.push_back(len - 3);
-        chunk.indices.push_back(len - 2);
-        chunk.indices.push_back(len - 2);
-        chunk.indices.push_back(len - 1);
-        chunk.indices.push_back(len - 4);
+    if (is_face_visible(cube.type, right)) {
+        mesh.vertices.push_back({{cube.pos.x + size, cube.pos.y, cube.pos.z}, colors[i], {0.0f, 0.0f, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x + size, cube.pos.y + size, cube.pos.z}, colors[i], {0.0f, size, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x + size, cube.pos.y + size, cube.pos.z + size}, colors[i], {size, size, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x + size, cube.pos.y, cube.pos.z + size}, colors[i], {size, 0.0f, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+
+        size_t len = mesh.vertices.size();
+        mesh.indices.push_back(len - 4);
+        mesh.indices.push_back(len - 3);
+        mesh.indices.push_back(len - 2);
+        mesh.indices.push_back(len - 2);
+        mesh.indices.push_back(len - 1);
+        mesh.indices.push_back(len - 4);
         cube.faces += 1;
     }
     i++;
     //right
-    if (left == 0) {
-        chunk.vertices.push_back({{cube.pos.x, cube.pos.y, cube.pos.z}, colors[i], {texture_coords[i][0], texture_coords[i][1]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x, cube.pos.y + 1.0f, cube.pos.z}, colors[i], {texture_coords[i][0], texture_coords[i][1] + offset}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x, cube.pos.y + 1.0f, cube.pos.z + 1.0f}, colors[i], {texture_coords[i][0] + offset, texture_coords[i][1] + offset}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-        chunk.vertices.push_back({{cube.pos.x, cube.pos.y, cube.pos.z + 1.0f}, colors[i], {texture_coords[i][0] + offset, texture_coords[i][1]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
-
-        size_t len = chunk.vertices.size();
-        chunk.indices.push_back(len - 4);
-        chunk.indices.push_back(len - 1);
-        chunk.indices.push_back(len - 2);
-        chunk.indices.push_back(len - 2);
-        chunk.indices.push_back(len - 3);
-        chunk.indices.push_back(len - 4);
+    if (is_face_visible(cube.type, left)) {
+        mesh.vertices.push_back({{cube.pos.x, cube.pos.y, cube.pos.z}, colors[i], {0.0f, 0.0f, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x, cube.pos.y + size, cube.pos.z}, colors[i], {0.0f, size, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x, cube.pos.y + size, cube.pos.z + size}, colors[i], {size, size, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+        mesh.vertices.push_back({{cube.pos.x, cube.pos.y, cube.pos.z + size}, colors[i], {size, 0.0f, layers[i]}, {cube.pos.x, cube.pos.y, cube.pos.z}});
+
+        size_t len = mesh.vertices.size();
+        mesh.indices.push_back(len - 4);
+        mesh.indices.push_back(len - 1);
+        mesh.indices.push_back(len - 2);
+        mesh.indices.push_back(len - 2);
+        mesh.indices.push_back(len - 3);
+        mesh.indices.push_back(len - 4);
         cube.faces += 1;
     }
 
@@ -1292,12 +1353,30 @@ void VkEngine::add_cube_to_vertices(Cube& cube, int up, int down, int left, int
     //     16, 15, 14, 14, 13, 16,
     //     20, 19, 18, 18, 17, 20,
     //     24, 21, 22, 22, 23, 24};
-    // size_t vect_len = chunk.vertices.size();
+    // size_t vect_len = mesh.vertices.size();
 
     // cube.pos.x -= chunk_pos.x * 16;
     // cube.pos.z -= chunk_pos.y * 16;
 }
 
+bool VkEngine::is_see_through(uint16_t type)
+{
+    return type == 0 || block_buckets[type] != BUCKET_OPAQUE;
+}
+
+float VkEngine::get_light_brightness(uint8_t light)
+{
+    // Each level below 15 dims by a fifth, level 0 is not fully black
+    int level = std::max(light >> 4, light & 0xf);
+    return 0.05f + 0.95f * powf(0.8f, 15 - level);
+}
+
+bool VkEngine::is_face_visible(uint16_t type, uint16_t neighbour)
+{
+    // Faces next to see-through blocks stay, except between blocks of the same type
+    return neighbour == 0 || (block_buckets[neighbour] != BUCKET_OPAQUE && neighbour != type);
+}
+
 void VkEngine::remove_face(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, int i, int indice)
 {
     vertices.erase(vertices.begin() + i, vertices.begin() + i + 4);
@@ -1311,17 +1390,18 @@ void VkEngine::remove_face(std::vector<Vertex>& vertices, std::vector<uint32_t>&
 
 void VkEngine::remove_cube_from_vertices(glm::vec3 pos, glm::vec2 chunk_pos, Chunk& chunk, Cube& cube)
 {
-    for (int i = 0; i < chunk.vertices.size(); i += 4) {
+    ChunkMesh& mesh = chunk.meshes[block_buckets[cube.type]];
+    for (int i = 0; i < mesh.vertices.size(); i += 4) {
         int indice = i / 4;
-        // std::cout << chunk.vertices[i].actual_block.x << " " << chunk.vertices[i].actual_block.y << " " << chunk.vertices[i].actual_block.z << std::endl;
+        // std::cout << mesh.vertices[i].actual_block.x << " " << mesh.vertices[i].actual_block.y << " " << mesh.vertices[i].actual_block.z << std::endl;
         // std::cout << cube.pos.x << " " << cube.pos.y << " " << cube.pos.z << std::endl;
-        if (chunk.vertices[i].actual_block == cube.pos) {
+        if (mesh.vertices[i].actual_block == cube.pos) {
             //std::cout << cube.faces << std::endl;
-            chunk.vertices.erase(chunk.vertices.begin() + i, chunk.vertices.begin() + i + (4 * cube.faces));
-            chunk.indices.erase(chunk.indices.begin() + indice * 6, chunk.indices.begin() + indice * 6 + (6 * cube.faces));
-            for (int j = 0; j < chunk.indices.size(); j++) {
-                if (chunk.indices[j] > i) {
-                    chunk.indices[j] -= 4 * cube.faces;
+            mesh.vertices.erase(mesh.vertices.begin() + i, mesh.vertices.begin() + i + (4 * cube.faces));
+            mesh.indices.erase(mesh.indices.begin() + indice * 6, mesh.indices.begin() + indice * 6 + (6 * cube.faces));
+            for (int j = 0; j < mesh.indices.size(); j++) {
+                if (mesh.indices[j] > i) {
+                    mesh.indices[j] -= 4 * cube.faces;
                 }
             }
             cube.faces = 0;
@@ -1334,34 +1414,126 @@ void VkEngine::create_texture_image()
 {
     int tex_width, tex_height, tex_channels;
     stbi_uc* pixels = stbi_load("img/texture_atlas.png", &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
-    VkDeviceSize image_size = tex_width * tex_height * 4;
 
     if (!pixels) {
         throw std::runtime_error("Could not load texture image");
     }
 
+    // Split the 16x16 tiles atlas into one array layer per block type
+    uint32_t tile_size = tex_width / 16;
+    VkDeviceSize layer_size = tile_size * tile_size * 4;
+    VkDeviceSize image_size = layer_size * TEXTURE_LAYERS;
+    vk_texture_mip_levels = static_cast<uint32_t>(std::floor(std::log2(tile_size))) + 1;
+
     VkBuffer staging_buffer;
     VkDeviceMemory staging_buffer_memory;
     create_buffer(image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory);
 
     void* data;
     vkMapMemory(device.device, staging_buffer_memory, 0, image_size, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(image_size));
+    for (uint32_t layer = 0; layer < TEXTURE_LAYERS; layer++) {
+        uint32_t tile_x = (layer % 16) * tile_size;
+        uint32_t tile_y = (layer / 16) * tile_size;
+        bool has_transparent = false;
+        bool has_translucent = false;
+        for (uint32_t row = 0; row < tile_size; row++) {
+            stbi_uc* src = pixels + ((tile_y + row) * tex_width + tile_x) * 4;
+            memcpy(static_cast<stbi_uc*>(data) + layer * layer_size + row * tile_size * 4, src, tile_size * 4);
+            for (uint32_t x = 0; x < tile_size; x++) {
+                stbi_uc alpha = src[x * 4 + 3];
+                has_transparent |= alpha < 26;
+                has_translucent |= alpha >= 26 && alpha < 255;
+            }
+        }
+        // Alpha below 0.1 is discarded by the cutout shader, anything in between needs blending
+        block_buckets[layer + 1] = has_translucent ? BUCKET_TRANSLUCENT : has_transparent ? BUCKET_CUTOUT : BUCKET_OPAQUE;
+    }
     vkUnmapMemory(device.device, staging_buffer_memory);
 
     stbi_image_free(pixels);
 
-    create_image(tex_width, tex_height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_texture_image, vk_texture_image_memory);
+    create_image(tile_size, tile_size, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_texture_image, vk_texture_image_memory, vk_texture_mip_levels, TEXTURE_LAYERS);
 
-    transition_image_layout(vk_texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copy_buffer_to_image(staging_buffer, vk_texture_image, static_cast<uint32_t>(tex_width), static_cast<uint32_t>(tex_height));
-    transition_image_layout(vk_texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    transition_image_layout(vk_texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, vk_texture_mip_levels, TEXTURE_LAYERS);
+    copy_buffer_to_image(staging_buffer, vk_texture_image, tile_size, tile_size, TEXTURE_LAYERS);
+    generate_mipmaps(vk_texture_image, VK_FORMAT_R8G8B8A8_SRGB, tile_size, tile_size, vk_texture_mip_levels, TEXTURE_LAYERS);
 
     vkDestroyBuffer(device.device, staging_buffer, nullptr);
     vkFreeMemory(device.device, staging_buffer_memory, nullptr);
 }
 
-void VkEngine::create_image(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& image_memory)
+void VkEngine::generate_mipmaps(VkImage image, VkFormat format, int32_t width, int32_t height, uint32_t mip_levels, uint32_t layer_count)
+{
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(device.physical_device, format, &format_properties);
+
+    if (!(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+        throw std::runtime_error("Could not generate mipmaps, texture format does not support linear blitting");
+    }
+
+    VkCommandBuffer command_buffer = begin_single_time_commands();
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = layer_count;
+    barrier.subresourceRange.levelCount = 1;
+
+    int32_t mip_width = width;
+    int32_t mip_height = height;
+
+    for (uint32_t i = 1; i < mip_levels; i++) {
+        barrier.subresourceRange.baseMipLevel = i - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkImageBlit blit = {};
+        blit.srcOffsets[0] = {0, 0, 0};
+        blit.srcOffsets[1] = {mip_width, mip_height, 1};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = i - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = layer_count;
+        blit.dstOffsets[0] = {0, 0, 0};
+        blit.dstOffsets[1] = {mip_width > 1 ? mip_width / 2 : 1, mip_height > 1 ? mip_height / 2 : 1, 1};
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = i;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = layer_count;
+        vkCmdBlitImage(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        if (mip_width > 1) {
+            mip_width /= 2;
+        }
+        if (mip_height > 1) {
+            mip_height /= 2;
+        }
+    }
+
+    barrier.subresourceRange.baseMipLevel = mip_levels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    end_single_time_commands(command_buffer);
+}
+
+void VkEngine::create_image(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& image_memory, uint32_t mip_levels, uint32_t array_layers)
 {
     VkImageCreateInfo image_info = {};
     image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1369,8 +1541,8 @@ void VkEngine::create_image(uint32_t width, uint32_t height, VkFormat format, Vk
     image_info.extent.width = width;
     image_info.extent.height = height;
     image_info.extent.depth = 1;
-    image_info.mipLevels = 1;
-    image_info.arrayLayers = 1;
+    image_info.mipLevels = mip_levels;
+    image_info.arrayLayers = array_layers;
     image_info.format = format;
     image_info.tiling = tiling;
     image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -1397,7 +1569,7 @@ void VkEngine::create_image(uint32_t width, uint32_t height, VkFormat format, Vk
     vkBindImageMemory(device.device, image, image_memory, 0);
 }
 
-void VkEngine::transition_image_layout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout)
+void VkEngine::transition_image_layout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout, uint32_t mip_levels, uint32_t layer_count)
 {
     VkCommandBuffer command_buffer = begin_single_time_commands();
 
@@ -1446,15 +1618,15 @@ void VkEngine::transition_image_layout(VkImage image, VkFormat format, VkImageLa
     }
 
     barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.levelCount = mip_levels;
     barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.layerCount = layer_count;
     vkCmdPipelineBarrier(command_buffer, source_stage, destination_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
     end_single_time_commands(command_buffer);
 }
 
-void VkEngine::copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void VkEngine::copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layer_count)
 {
     VkCommandBuffer command_buffer = begin_single_time_commands();
 
@@ -1466,7 +1638,7 @@ void VkEngine::copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t wid
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     region.imageSubresource.mipLevel = 0;
     region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
+    region.imageSubresource.layerCount = layer_count;
 
     region.imageOffset = {0, 0, 0};
     region.imageExtent = {width, height, 1};
@@ -1478,21 +1650,21 @@ void VkEngine::copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t wid
 
 void VkEngine::create_texture_image_view()
 {
-    vk_texture_image_view = create_image_view(vk_texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+    vk_texture_image_view = create_image_view(vk_texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, vk_texture_mip_levels, TEXTURE_LAYERS);
 }
 
-VkImageView VkEngine::create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags)
+VkImageView VkEngine::create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, VkImageViewType view_type, uint32_t mip_levels, uint32_t layer_count)
 {
     VkImageViewCreateInfo view_info = {};
     view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     view_info.image = image;
-    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.viewType = view_type;
     view_info.format = format;
     view_info.subresourceRange.aspectMask = aspect_flags;
     view_info.subresourceRange.baseMipLevel = 0;
-    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.levelCount = mip_levels;
     view_info.subresourceRange.baseArrayLayer = 0;
-    view_info.subresourceRange.layerCount = 1;
+    view_info.subresourceRange.layerCount = layer_count;
 
     VkImageView image_view;
     if (vkCreateImageView(device.device, &view_info, nullptr, &image_view) != VK_SUCCESS) {
@@ -1520,7 +1692,7 @@ void VkEngine::create_texture_sampler()
     sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     sampler_info.mipLodBias = 0.0f;
     sampler_info.minLod = 0.0f;
-    sampler_info.maxLod = 0.0f;
+    sampler_info.maxLod = static_cast<float>(vk_texture_mip_levels);
 
     if (vkCreateSampler(device.device, &sampler_info, nullptr, &vk_texture_sampler) != VK_SUCCESS) {
         throw std::runtime_error("Could not create texture sampler");
@@ -1565,55 +1737,78 @@ bool VkEngine::has_stencil_component(VkFormat format)
 
 void VkEngine::create_vertex_buffer_chunk(Chunk& chunk)
 {
-    VkDeviceSize buffer_size = sizeof(chunk.vertices[0]) * chunk.vertices.size();
+    for (auto& mesh : chunk.meshes) {
+        if (mesh.vertices.empty()) {
+            continue;
+        }
+        VkDeviceSize buffer_size = sizeof(mesh.vertices[0]) * mesh.vertices.size();
 
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory);
+        VkBuffer staging_buffer;
+        VkDeviceMemory staging_buffer_memory;
+        create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory);
 
-    void* data;
-    vkMapMemory(device.device, staging_buffer_memory, 0, buffer_size, 0, &data);
-    memcpy(data, chunk.vertices.data(), (size_t) buffer_size);
-    vkUnmapMemory(device.device, staging_buffer_memory);
+        void* data;
+        vkMapMemory(device.device, staging_buffer_memory, 0, buffer_size, 0, &data);
+        memcpy(data, mesh.vertices.data(), (size_t) buffer_size);
+        vkUnmapMemory(device.device, staging_buffer_memory);
 
-    //std::cout << "Buffer size chunk: " << buffer_size << std::endl;
-    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, chunk.vk_vertex_buffer, chunk.vk_vertex_buffer_memory);
+        //std::cout << "Buffer size chunk: " << buffer_size << std::endl;
+        create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mesh.vk_vertex_buffer, mesh.vk_vertex_buffer_memory);
 
-    copy_buffer(staging_buffer, chunk.vk_vertex_buffer, buffer_size);
+        copy_buffer(staging_buffer, mesh.vk_vertex_buffer, buffer_size);
 
-    vkDestroyBuffer(device.device, staging_buffer, nullptr);
-    vkFreeMemory(device.device, staging_buffer_memory, nullptr);
+        vkDestroyBuffer(device.device, staging_buffer, nullptr);
+        vkFreeMemory(device.device, staging_buffer_memory, nullptr);
+    }
 }
 
 void VkEngine::create_index_buffer_chunk(Chunk& chunk)
 {
-    VkDeviceSize buffer_size = sizeof(chunk.indices[0]) * chunk.indices.size();
+    for (auto& mesh : chunk.meshes) {
+        if (mesh.indices.empty()) {
+            continue;
+        }
+        VkDeviceSize buffer_size = sizeof(mesh.indices[0]) * mesh.indices.size();
 
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory);
+        VkBuffer staging_buffer;
+        VkDeviceMemory staging_buffer_memory;
+        create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory);
 
-    void* data;
-    vkMapMemory(device.device, staging_buffer_memory, 0, buffer_size, 0, &data);
-    memcpy(data, chunk.indices.data(), (size_t) buffer_size);
-    vkUnmapMemory(device.device, staging_buffer_memory);
+        void* data;
+        vkMapMemory(device.device, staging_buffer_memory, 0, buffer_size, 0, &data);
+        memcpy(data, mesh.indices.data(), (size_t) buffer_size);
+        vkUnmapMemory(device.device, staging_buffer_memory);
 
-    //std::cout << "Buffer size chunk indices: " << buffer_size << std::endl;
-    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, chunk.vk_index_buffer, chunk.vk_index_buffer_memory);
+        // A sort of the previous mesh doesn't match these indices
+        mesh.sorted_indices.clear();
+        //std::cout << "Buffer size chunk indices: " << buffer_size << std::endl;
+        create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mesh.vk_index_buffer, mesh.vk_index_buffer_memory);
 
-    copy_buffer(staging_buffer, chunk.vk_index_buffer, buffer_size);
+        copy_buffer(staging_buffer, mesh.vk_index_buffer, buffer_size);
 
-    vkDestroyBuffer(device.device, staging_buffer, nullptr);
-    vkFreeMemory(device.device, staging_buffer_memory, nullptr);
+        vkDestroyBuffer(device.device, staging_buffer, nullptr);
+        vkFreeMemory(device.device, staging_buffer_memory, nullptr);
+    }
+}
+
+void VkEngine::destroy_buffers_chunk(Chunk& chunk)
+{
+    for (auto& mesh : chunk.meshes) {
+        vkDestroyBuffer(device.device, mesh.vk_vertex_buffer, nullptr);
+        vkFreeMemory(device.device, mesh.vk_vertex_buffer_memory, nullptr);
+        vkDestroyBuffer(device.device, mesh.vk_index_buffer, nullptr);
+        vkFreeMemory(device.device, mesh.vk_index_buffer_memory, nullptr);
+        mesh.vk_vertex_buffer = VK_NULL_HANDLE;
+        mesh.vk_vertex_buffer_memory = VK_NULL_HANDLE;
+        mesh.vk_index_buffer = VK_NULL_HANDLE;
+        mesh.vk_index_buffer_memory = VK_NULL_HANDLE;
+    }
 }
 
 void VkEngine::free_buffers_chunk(Chunk& chunk)
 {
     wait_idle();
-    vkDestroyBuffer(device.device, chunk.vk_vertex_buffer, nullptr);
-    vkFreeMemory(device.device, chunk.vk_vertex_buffer_memory, nullptr);
-    vkDestroyBuffer(device.device, chunk.vk_index_buffer, nullptr);
-    vkFreeMemory(device.device, chunk.vk_index_buffer_memory, nullptr);
+    destroy_buffers_chunk(chunk);
 }
 
 void VkEngine::recreate_buffers_chunk(Chunk& chunk)
@@ -1624,6 +1819,118 @@ void VkEngine::recreate_buffers_chunk(Chunk& chunk)
     create_index_buffer_chunk(chunk);
 }
 
+void VkEngine::recreate_buffers_chunks(const std::vector<Chunk*>& chunks)
+{
+    if (chunks.empty()) {
+        return;
+    }
+    wait_idle();
+    for (Chunk* chunk : chunks) {
+        destroy_buffers_chunk(*chunk);
+        create_vertex_buffer_chunk(*chunk);
+        create_index_buffer_chunk(*chunk);
+    }
+}
+
+void VkEngine::sort_translucent_faces(Chunk& chunk, glm::vec3 camera_pos)
+{
+    // The mesh keeps its indices in face order for editing, only the GPU copy is sorted
+    ChunkMesh& mesh = chunk.meshes[BUCKET_TRANSLUCENT];
+    if (mesh.indices.empty() || mesh.vk_index_buffer == VK_NULL_HANDLE) {
+        return;
+    }
+
+    size_t face_count = mesh.indices.size() / 6;
+    std::vector<std::pair<float, uint32_t>> faces(face_count);
+    for (size_t i = 0; i < face_count; i++) {
+        glm::vec3 center = (mesh.vertices[i * 4].pos + mesh.vertices[i * 4 + 2].pos) * 0.5f - camera_pos;
+        faces[i] = {glm::dot(center, center), static_cast<uint32_t>(i)};
+    }
+    std::sort(faces.begin(), faces.end(), [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) {
+        return a.first > b.first;
+    });
+
+    mesh.sorted_indices.clear();
+    mesh.sorted_indices.reserve(mesh.indices.size());
+    for (auto& face : faces) {
+        mesh.sorted_indices.insert(mesh.sorted_indices.end(), mesh.indices.begin() + face.second * 6, mesh.indices.begin() + face.second * 6 + 6);
+    }
+}
+
+void VkEngine::record_translucent_sorts(VkCommandBuffer command_buffer, std::vector<Chunk>& world)
+{
+    // Every sort since the last frame goes through this frame's staging
+    // buffer, copied before the render pass instead of waiting on the queue
+    std::vector<ChunkMesh*> sorted;
+    VkDeviceSize total_size = 0;
+    for (auto& chunk : world) {
+        ChunkMesh& mesh = chunk.meshes[BUCKET_TRANSLUCENT];
+        if (mesh.sorted_indices.empty()) {
+            continue;
+        }
+        if (chunk.should_be_deleted || mesh.vk_index_buffer == VK_NULL_HANDLE || mesh.sorted_indices.size() != mesh.indices.size()) {
+            mesh.sorted_indices.clear();
+            continue;
+        }
+        sorted.push_back(&mesh);
+        total_size += sizeof(uint32_t) * mesh.sorted_indices.size();
+    }
+    if (sorted.empty()) {
+        return;
+    }
+
+    if (sort_staging_sizes.empty()) {
+        vk_sort_staging_buffers.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+        vk_sort_staging_buffers_memory.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+        vk_sort_staging_buffers_mapped.resize(MAX_FRAMES_IN_FLIGHT, nullptr);
+        sort_staging_sizes.resize(MAX_FRAMES_IN_FLIGHT, 0);
+    }
+    if (sort_staging_sizes[current_frame] < total_size) {
+        // The fence of this frame was waited on, its copies are done
+        if (vk_sort_staging_buffers[current_frame] != VK_NULL_HANDLE) {
+            vkUnmapMemory(device.device, vk_sort_staging_buffers_memory[current_frame]);
+            vkDestroyBuffer(device.device, vk_sort_staging_buffers[current_frame], nullptr);
+            vkFreeMemory(device.device, vk_sort_staging_buffers_memory[current_frame], nullptr);
+        }
+        VkDeviceSize buffer_size = std::max(total_size, sort_staging_sizes[current_frame] * 2);
+        create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vk_sort_staging_buffers[current_frame], vk_sort_staging_buffers_memory[current_frame]);
+        vkMapMemory(device.device, vk_sort_staging_buffers_memory[current_frame], 0, buffer_size, 0, &vk_sort_staging_buffers_mapped[current_frame]);
+        sort_staging_sizes[current_frame] = buffer_size;
+    }
+
+    // Frames still in flight may be drawing with the old order
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    std::vector<VkBufferMemoryBarrier> barriers;
+    char* staging = static_cast<char*>(vk_sort_staging_buffers_mapped[current_frame]);
+    VkDeviceSize offset = 0;
+    for (ChunkMesh* mesh : sorted) {
+        VkDeviceSize size = sizeof(uint32_t) * mesh->sorted_indices.size();
+        memcpy(staging + offset, mesh->sorted_indices.data(), (size_t) size);
+        mesh->sorted_indices.clear();
+
+        VkBufferCopy copy_region = {};
+        copy_region.srcOffset = offset;
+        copy_region.size = size;
+        vkCmdCopyBuffer(command_buffer, vk_sort_staging_buffers[current_frame], mesh->vk_index_buffer, 1, &copy_region);
+        offset += size;
+
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = mesh->vk_index_buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        barriers.push_back(barrier);
+    }
+
+    // The translucent draws of this frame read the new order
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+}
+
 static void check_vk_result(VkResult err)
 {
     if (err == 0)
@@ -1872,11 +2179,11 @@ void VkEngine::create_particles_buffers()
         return;
     }
 
-    float offset = 1.0f / 16.0f;
-    particles_vertices.push_back({{-0.5f, -0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}});
-    particles_vertices.push_back({{0.5f, -0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {offset, 0.0f}, {0.0f, 0.0f, 0.0f}});
-    particles_vertices.push_back({{0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {offset, offset}, {0.0f, 0.0f, 0.0f}});
-    particles_vertices.push_back({{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, offset}, {0.0f, 0.0f, 0.0f}});
+    // The layer is picked per instance in the vertex shader
+    particles_vertices.push_back({{-0.5f, -0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}});
+    particles_vertices.push_back({{0.5f, -0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}});
+    particles_vertices.push_back({{0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 0.0f}});
+    particles_vertices.push_back({{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 0.0f}});
 
     size_t len = particles_vertices.size();
     particles_indices.push_back(len - 4);
@@ -1922,90 +2229,250 @@ void VkEngine::create_particles_buffers()
     vkDestroyBuffer(device.device, staging_buffer_i, nullptr);
     vkFreeMemory(device.device, staging_buffer_memory_i, nullptr);
 
-    create_particles_instance_buffers();
+    create_particles_compute_buffers();
+    create_particles_cpu_buffers();
+    create_particles_compute_descriptor_sets();
+    create_particles_compute_pipeline();
 }
 
-void VkEngine::create_particles_instance_buffers()
+void VkEngine::create_particles_compute_buffers()
 {
-    if (vk_particles_instance_buffer != VK_NULL_HANDLE) {
-        wait_idle();
-        vkDestroyBuffer(device.device, vk_particles_instance_buffer, nullptr);
-        vkFreeMemory(device.device, vk_particles_instance_buffer_memory, nullptr);
+    VkDeviceSize buffer_size_instance = sizeof(ParticleInstanceData) * MAX_PARTICLES;
+    create_buffer(buffer_size_instance, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_particles_instance_buffer, vk_particles_instance_buffer_memory);
+
+    vk_particles_storage_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+    vk_particles_storage_buffers_memory.resize(MAX_FRAMES_IN_FLIGHT);
+    vk_particles_spawn_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+    vk_particles_spawn_buffers_memory.resize(MAX_FRAMES_IN_FLIGHT);
+    vk_particles_spawn_buffers_mapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+    VkDeviceSize buffer_size_storage = sizeof(Particle) * MAX_PARTICLES;
+    VkDeviceSize buffer_size_spawn = sizeof(Particle) * MAX_PARTICLE_SPAWNS;
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        create_buffer(buffer_size_storage, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_particles_storage_buffers[i], vk_particles_storage_buffers_memory[i]);
+        create_buffer(buffer_size_spawn, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vk_particles_spawn_buffers[i], vk_particles_spawn_buffers_memory[i]);
+        vkMapMemory(device.device, vk_particles_spawn_buffers_memory[i], 0, buffer_size_spawn, 0, &vk_particles_spawn_buffers_mapped[i]);
     }
 
-    VkDeviceSize buffer_size_instance = sizeof(ParticleInstanceData) * MAX_PARTICLES;
+    // One draw command per frame, the compute shader counts the living particles into instanceCount
+    std::vector<VkDrawIndexedIndirectCommand> commands(MAX_FRAMES_IN_FLIGHT);
+    for (auto& command : commands) {
+        command.indexCount = static_cast<uint32_t>(particles_indices.size());
+        command.instanceCount = 0;
+        command.firstIndex = 0;
+        command.vertexOffset = 0;
+        command.firstInstance = 0;
+    }
+
+    VkDeviceSize buffer_size_indirect = sizeof(VkDrawIndexedIndirectCommand) * commands.size();
 
-    VkBuffer staging_buffer_instance;
-    VkDeviceMemory staging_buffer_memory_instance;
-    create_buffer(buffer_size_instance, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer_instance, staging_buffer_memory_instance);
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_buffer_memory;
+    create_buffer(buffer_size_indirect, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory);
 
-    void* data_instance;
-    vkMapMemory(device.device, staging_buffer_memory_instance, 0, buffer_size_instance, 0, &data_instance);
-    memset(data_instance, 0, (size_t) buffer_size_instance);
-    vkUnmapMemory(device.device, staging_buffer_memory_instance);
+    void* data;
+    vkMapMemory(device.device, staging_buffer_memory, 0, buffer_size_indirect, 0, &data);
+    memcpy(data, commands.data(), (size_t) buffer_size_indirect);
+    vkUnmapMemory(device.device, staging_buffer_memory);
 
-    create_buffer(buffer_size_instance, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_particles_instance_buffer, vk_particles_instance_buffer_memory);
+    create_buffer(buffer_size_indirect, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_particles_indirect_buffer, vk_particles_indirect_buffer_memory);
 
-    copy_buffer(staging_buffer_instance, vk_particles_instance_buffer, buffer_size_instance);
+    copy_buffer(staging_buffer, vk_particles_indirect_buffer, buffer_size_indirect);
 
-    vkDestroyBuffer(device.device, staging_buffer_instance, nullptr);
-    vkFreeMemory(device.device, staging_buffer_memory_instance, nullptr);
+    vkDestroyBuffer(device.device, staging_buffer, nullptr);
+    vkFreeMemory(device.device, staging_buffer_memory, nullptr);
 }
 
-void VkEngine::create_particles(glm::vec3 pos, uint16_t type, Player& player)
+void VkEngine::create_particles_cpu_buffers()
 {
-    if (particles.size() >= MAX_PARTICLES) {
-        return;
+    vk_particles_cpu_instance_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+    vk_particles_cpu_instance_buffers_memory.resize(MAX_FRAMES_IN_FLIGHT);
+    vk_particles_cpu_instance_buffers_mapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+    VkDeviceSize buffer_size = sizeof(ParticleInstanceData) * particle_pool.capacity;
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        create_buffer(buffer_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vk_particles_cpu_instance_buffers[i], vk_particles_cpu_instance_buffers_memory[i]);
+        vkMapMemory(device.device, vk_particles_cpu_instance_buffers_memory[i], 0, buffer_size, 0, &vk_particles_cpu_instance_buffers_mapped[i]);
+    }
+}
+
+void VkEngine::create_particles_compute_descriptor_sets()
+{
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings = {};
+    for (size_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = static_cast<uint32_t>(i);
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
     }
 
-    std::array<Particle, 4> parts{
-        Particle{{pos.x + rand_float(0.0f, 1.0f), pos.y + rand_float(0.0f, 0.2f), pos.z + rand_float(0.0f, 1.0f)}, {rand_float(-0.05, 0.05), rand_float(-0.05, 0.01), rand_float(-0.05, 0.05)}, {1.0f, 1.0f, 1.0f}, rand_float(0.1f, 0.3f), 0},
-        Particle{{pos.x + rand_float(0.0f, 1.0f), pos.y + rand_float(0.0f, 0.2f), pos.z + rand_float(0.0f, 1.0f)}, {rand_float(-0.05, 0.05), rand_float(-0.05, 0.01), rand_float(-0.05, 0.05)}, {1.0f, 1.0f, 1.0f}, rand_float(0.1f, 0.3f), 0},
-        Particle{{pos.x + rand_float(0.0f, 1.0f), pos.y + rand_float(0.0f, 0.2f), pos.z + rand_float(0.0f, 1.0f)}, {rand_float(-0.05, 0.05), rand_float(-0.05, 0.01), rand_float(-0.05, 0.05)}, {1.0f, 1.0f, 1.0f}, rand_float(0.1f, 0.3f), 0},
-        Particle{{pos.x + rand_float(0.0f, 1.0f), pos.y + rand_float(0.0f, 0.2f), pos.z + rand_float(0.0f, 1.0f)}, {rand_float(-0.05, 0.05), rand_float(-0.05, 0.01), rand_float(-0.05, 0.05)}, {1.0f, 1.0f, 1.0f}, rand_float(0.1f, 0.3f), 0}
-    };
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+    layout_info.pBindings = bindings.data();
 
-    for (auto& part : parts) {
-        particles.push_back(part);
-        particles_instance_data.push_back({{part.position.x, part.position.y, part.position.z}, part.size, type});
+    if (vkCreateDescriptorSetLayout(device.device, &layout_info, nullptr, &vk_particles_compute_descriptor_set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Could not create particles descriptor set layout");
     }
 
-    VkCommandBuffer command_buffer = begin_single_time_commands();
+    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, vk_particles_compute_descriptor_set_layout);
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = vk_descriptor_pool;
+    alloc_info.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    alloc_info.pSetLayouts = layouts.data();
 
-    vkCmdUpdateBuffer(command_buffer, vk_particles_instance_buffer, 0, sizeof(ParticleInstanceData) * particles_instance_data.size(), particles_instance_data.data());
+    vk_particles_compute_descriptor_sets.resize(MAX_FRAMES_IN_FLIGHT);
+    if (vkAllocateDescriptorSets(device.device, &alloc_info, vk_particles_compute_descriptor_sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Could not allocate particles descriptor sets");
+    }
 
-    end_single_time_commands(command_buffer);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        std::array<VkDescriptorBufferInfo, 5> buffer_infos = {};
+        buffer_infos[0].buffer = vk_particles_storage_buffers[(i + 1) % MAX_FRAMES_IN_FLIGHT];
+        buffer_infos[1].buffer = vk_particles_storage_buffers[i];
+        buffer_infos[2].buffer = vk_particles_spawn_buffers[i];
+        buffer_infos[3].buffer = vk_particles_instance_buffer;
+        buffer_infos[4].buffer = vk_particles_indirect_buffer;
+
+        std::array<VkWriteDescriptorSet, 5> descriptor_writes = {};
+        for (size_t j = 0; j < descriptor_writes.size(); j++) {
+            buffer_infos[j].offset = 0;
+            buffer_infos[j].range = VK_WHOLE_SIZE;
+
+            descriptor_writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptor_writes[j].dstSet = vk_particles_compute_descriptor_sets[i];
+            descriptor_writes[j].dstBinding = static_cast<uint32_t>(j);
+            descriptor_writes[j].dstArrayElement = 0;
+            descriptor_writes[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptor_writes[j].descriptorCount = 1;
+            descriptor_writes[j].pBufferInfo = &buffer_infos[j];
+        }
+
+        vkUpdateDescriptorSets(device.device, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+    }
 }
 
-void VkEngine::update_particles()
+void VkEngine::create_particles_compute_pipeline()
 {
-    if (particles.size() == 0 || particles_instance_data.size() == 0) {
-        return;
+    auto comp_shader_code = read_file("shaders/particles_comp.spv");
+    VkShaderModule comp_shader_module = create_shader_module(comp_shader_code, device.device);
+
+    VkPipelineShaderStageCreateInfo comp_shader_stage_info = {};
+    comp_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    comp_shader_stage_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    comp_shader_stage_info.module = comp_shader_module;
+    comp_shader_stage_info.pName = "main";
+
+    VkPushConstantRange push_constant_range = {};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(ParticlePushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &vk_particles_compute_descriptor_set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+    if (vkCreatePipelineLayout(device.device, &pipeline_layout_info, nullptr, &vk_particles_compute_pipeline_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Could not create compute pipeline layout");
     }
 
-    int index = 0;
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage = comp_shader_stage_info;
+    pipeline_info.layout = vk_particles_compute_pipeline_layout;
 
-    for (auto& particle : particles) {
-        particle.position += particle.velocity;
-        particle.velocity.y += 0.01f;
-        particle.life += 0.01f;
-        particles_instance_data[index].pos = {particle.position.x, particle.position.y, particle.position.z};
-        if (particle.life > 0.5f) {
-            particles.erase(particles.begin() + index);
-            particles_instance_data.erase(particles_instance_data.begin() + index);
-        }
-        index++;
+    if (vkCreateComputePipelines(device.device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &vk_particles_compute_pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Could not create compute pipeline");
     }
 
-    if (particles.size() == 0 || particles_instance_data.size() == 0) {
+    vkDestroyShaderModule(device.device, comp_shader_module, nullptr);
+}
+
+void VkEngine::create_particles(glm::vec3 pos, uint16_t type, Player& player)
+{
+    if (pending_particles.size() >= MAX_PARTICLES) {
         return;
     }
 
-    VkCommandBuffer command_buffer = begin_single_time_commands();
+    for (int i = 0; i < 4; i++) {
+        Particle particle = {{pos.x + rand_float(0.0f, 1.0f), pos.y + rand_float(0.0f, 0.2f), pos.z + rand_float(0.0f, 1.0f)}, rand_float(0.1f, 0.3f), {rand_float(-0.05, 0.05), rand_float(-0.05, 0.01), rand_float(-0.05, 0.05)}, 0.0f, type};
+        if (gpu_particles) {
+            pending_particles.push_back(particle);
+        } else {
+            particle_pool.spawn(particle);
+        }
+    }
+}
 
-    vkCmdUpdateBuffer(command_buffer, vk_particles_instance_buffer, 0, sizeof(ParticleInstanceData) * particles_instance_data.size(), particles_instance_data.data());
+void VkEngine::tick_particles()
+{
+    // Both simulations catch up on the ticks when the next frame is drawn
+    particle_ticks++;
+}
 
-    end_single_time_commands(command_buffer);
+void VkEngine::update_particles()
+{
+    upload_particle_spawns();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < particle_ticks && particle_pool.count > 0; i++) {
+        particle_pool.update();
+    }
+    if (particle_pool.count > 0) {
+        particle_pool.write_instances(static_cast<ParticleInstanceData*>(vk_particles_cpu_instance_buffers_mapped[current_frame]), particle_alpha);
+    }
+    particles_update_duration = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void VkEngine::upload_particle_spawns()
+{
+    // Only the new particles go through the host, the rest stays on the GPU
+    particles_spawn_count = std::min(static_cast<uint32_t>(pending_particles.size()), MAX_PARTICLE_SPAWNS);
+    if (particles_spawn_count == 0) {
+        return;
+    }
+
+    memcpy(vk_particles_spawn_buffers_mapped[current_frame], pending_particles.data(), sizeof(Particle) * particles_spawn_count);
+    pending_particles.erase(pending_particles.begin(), pending_particles.begin() + particles_spawn_count);
+}
+
+void VkEngine::record_particles_compute(VkCommandBuffer command_buffer)
+{
+    ParticlePushConstants push_constants = {};
+    push_constants.src_command = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+    push_constants.dst_command = current_frame;
+    push_constants.spawn_count = particles_spawn_count;
+    push_constants.max_particles = MAX_PARTICLES;
+    push_constants.steps = particle_ticks;
+    push_constants.alpha = particle_alpha;
+
+    // The previous frame may still be reading what this dispatch overwrites
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkDeviceSize count_offset = push_constants.dst_command * sizeof(VkDrawIndexedIndirectCommand) + offsetof(VkDrawIndexedIndirectCommand, instanceCount);
+    vkCmdFillBuffer(command_buffer, vk_particles_indirect_buffer, count_offset, sizeof(uint32_t), 0);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_particles_compute_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_particles_compute_pipeline_layout, 0, 1, &vk_particles_compute_descriptor_sets[current_frame], 0, nullptr);
+    vkCmdPushConstants(command_buffer, vk_particles_compute_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ParticlePushConstants), &push_constants);
+    vkCmdDispatch(command_buffer, (MAX_PARTICLES + particles_spawn_count + 255) / 256, 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 }
 
 void VkEngine::wait_idle()
@@ -2024,6 +2491,28 @@ VkEngine::~VkEngine()
         vkFreeMemory(device.device, vk_particles_index_buffer_memory, nullptr);
         vkDestroyBuffer(device.device, vk_particles_instance_buffer, nullptr);
         vkFreeMemory(device.device, vk_particles_instance_buffer_memory, nullptr);
+        vkDestroyBuffer(device.device, vk_particles_indirect_buffer, nullptr);
+        vkFreeMemory(device.device, vk_particles_indirect_buffer_memory, nullptr);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkDestroyBuffer(device.device, vk_particles_storage_buffers[i], nullptr);
+            vkFreeMemory(device.device, vk_particles_storage_buffers_memory[i], nullptr);
+            vkUnmapMemory(device.device, vk_particles_spawn_buffers_memory[i]);
+            vkDestroyBuffer(device.device, vk_particles_spawn_buffers[i], nullptr);
+            vkFreeMemory(device.device, vk_particles_spawn_buffers_memory[i], nullptr);
+            vkUnmapMemory(device.device, vk_particles_cpu_instance_buffers_memory[i]);
+            vkDestroyBuffer(device.device, vk_particles_cpu_instance_buffers[i], nullptr);
+            vkFreeMemory(device.device, vk_particles_cpu_instance_buffers_memory[i], nullptr);
+        }
+        vkDestroyPipeline(device.device, vk_particles_compute_pipeline, nullptr);
+        vkDestroyPipelineLayout(device.device, vk_particles_compute_pipeline_layout, nullptr);
+        vkDestroyDescriptorSetLayout(device.device, vk_particles_compute_descriptor_set_layout, nullptr);
+    }
+    for (size_t i = 0; i < vk_sort_staging_buffers.size(); i++) {
+        if (vk_sort_staging_buffers[i] != VK_NULL_HANDLE) {
+            vkUnmapMemory(device.device, vk_sort_staging_buffers_memory[i]);
+            vkDestroyBuffer(device.device, vk_sort_staging_buffers[i], nullptr);
+            vkFreeMemory(device.device, vk_sort_staging_buffers_memory[i], nullptr);
+        }
     }
 
     vkDestroyImageView(device.device, vk_depth_image_view, nullptr);
@@ -2065,10 +2554,7 @@ VkEngine::~VkEngine()
 
     vkDestroyCommandPool(device.device, vk_command_pool, nullptr);
 
-    vkDestroyPipeline(device.device, vk_graphics_pipeline, nullptr);
-    vkDestroyPipelineLayout(device.device, vk_pipeline_layout, nullptr);
-    vkDestroyPipeline(device.device, vk_particles_graphics_pipeline, nullptr);
-    vkDestroyPipelineLayout(device.device, vk_particles_pipeline_layout, nullptr);
+    destroy_all_graphics_pipelines();
 
     vkDestroyRenderPass(device.device, vk_render_pass, nullptr);
     for (auto framebuffer : vk_framebuffers) {
@@ -0,0 +1,227 @@
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+
+#include "WorldGenerator.hpp"
+#include "NoiseBatch.hpp"
+#include "StaticNoise.hpp"
+
+WorldGenerator::WorldGenerator()
+{
+    StaticNoise<TerrainNoiseConfig>::configure(noise);
+    StaticNoise<BiomeNoiseConfig>::configure(biome_noise);
+
+    density_noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+    density_noise.SetFrequency(0.04f);
+    cave_noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+    cave_noise.SetFrequency(0.06f);
+}
+
+WorldGenerator::~WorldGenerator()
+{
+}
+
+void WorldGenerator::set_seed(uint32_t seed)
+{
+    this->seed = seed;
+    noise.SetSeed((int)ChunkRandom::mix(seed ^ 0x100000000ull));
+    biome_noise.SetSeed((int)ChunkRandom::mix(seed ^ 0x200000000ull));
+    density_noise.SetSeed((int)ChunkRandom::mix(seed ^ 0x300000000ull));
+    cave_noise.SetSeed((int)ChunkRandom::mix(seed ^ 0x400000000ull));
+    clear_columns_cache();
+}
+
+ChunkRandom WorldGenerator::get_chunk_random(glm::ivec2 chunk_pos, uint32_t stream)
+{
+    return ChunkRandom(seed, chunk_pos, stream);
+}
+
+ChunkColumns WorldGenerator::get_columns(glm::ivec2 chunk_pos)
+{
+    uint64_t key = get_chunk_key(chunk_pos);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = columns_cache_index.find(key);
+        if (found != columns_cache_index.end()) {
+            columns_cache_hits++;
+            columns_cache.splice(columns_cache.begin(), columns_cache, found->second);
+            return found->second->second;
+        }
+        columns_cache_misses++;
+    }
+
+    // Generated without the lock so workers don't wait on each other, two
+    // of them missing the same chunk compute the same columns
+    ChunkColumns columns;
+    get_heights(glm::vec2(chunk_pos), columns.heights);
+    columns.biome = get_biome(glm::vec2(chunk_pos));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (columns_cache_index.count(key)) {
+        return columns;
+    }
+    if (columns_cache.size() >= columns_cache_capacity && !columns_cache.empty()) {
+        columns_cache_index.erase(columns_cache.back().first);
+        columns_cache.pop_back();
+    }
+    columns_cache.emplace_front(key, columns);
+    columns_cache_index[key] = columns_cache.begin();
+    return columns;
+}
+
+int WorldGenerator::get_height(int x, int z)
+{
+    glm::ivec2 chunk_pos(x >= 0 ? x / 16 : (x + 1) / 16 - 1, z >= 0 ? z / 16 : (z + 1) / 16 - 1);
+    return get_columns(chunk_pos).heights[(x - chunk_pos.x * 16) * 16 + z - chunk_pos.y * 16];
+}
+
+void WorldGenerator::clear_columns_cache()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    columns_cache.clear();
+    columns_cache_index.clear();
+}
+
+size_t WorldGenerator::get_columns_cache_size()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return columns_cache.size();
+}
+
+size_t WorldGenerator::get_columns_cache_memory()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // List node with two pointers, plus a hash node and bucket per entry
+    size_t entry = sizeof(std::pair<uint64_t, ChunkColumns>) + 2 * sizeof(void*);
+    size_t index_entry = sizeof(std::pair<uint64_t, void*>) + 2 * sizeof(void*);
+    return columns_cache.size() * (entry + index_entry) + columns_cache_index.bucket_count() * sizeof(void*);
+}
+
+WorldGenerator::Stats WorldGenerator::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return {height_samples, worst_height_error, height_error_columns, generation_ms};
+}
+
+float WorldGenerator::get_columns_cache_hit_rate()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = columns_cache_hits + columns_cache_misses;
+    return total == 0 ? 0.0f : (float)columns_cache_hits / total;
+}
+
+int WorldGenerator::get_biome(glm::vec2 chunk_pos)
+{
+    return (int)abs(StaticNoise<BiomeNoiseConfig>(biome_noise).get_noise(chunk_pos.x, chunk_pos.y) * 10);
+}
+
+void WorldGenerator::get_heights(glm::vec2 chunk_pos, std::array<int, 256>& heights)
+{
+    std::array<float, 256> full;
+    bool verify = verify_heights;
+    size_t samples = 0;
+    if (height_step <= 1 || verify) {
+        NoiseBatch::get_noise_grid(noise, chunk_pos.x * 16, chunk_pos.y * 16, full.data());
+        samples += 256;
+    }
+
+    if (height_step <= 1) {
+        for (int i = 0; i < 256; i++) {
+            heights[i] = (int)(full[i] * 10) + 10;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        height_samples += samples;
+        return;
+    }
+
+    // Lattice corners include the first column of the next chunk so neighbours share them
+    StaticNoise<TerrainNoiseConfig> terrain(noise);
+    int cells = 16 / height_step;
+    std::array<float, 17 * 17> lattice;
+    for (int x = 0; x <= cells; x++) {
+        for (int z = 0; z <= cells; z++) {
+            lattice[x * 17 + z] = terrain.get_noise((float)(x * height_step + chunk_pos.x * 16), (float)(z * height_step + chunk_pos.y * 16));
+        }
+    }
+    samples += (cells + 1) * (cells + 1);
+
+    for (int x = 0; x < 16; x++) {
+        int cx = x / height_step;
+        float fx = (float)(x % height_step) / height_step;
+        for (int z = 0; z < 16; z++) {
+            int cz = z / height_step;
+            float fz = (float)(z % height_step) / height_step;
+            float n0 = glm::mix(lattice[cx * 17 + cz], lattice[(cx + 1) * 17 + cz], fx);
+            float n1 = glm::mix(lattice[cx * 17 + cz + 1], lattice[(cx + 1) * 17 + cz + 1], fx);
+            heights[x * 16 + z] = (int)(glm::mix(n0, n1, fz) * 10) + 10;
+        }
+    }
+
+    int worst = 0;
+    size_t error_columns = 0;
+    for (int i = 0; i < 256 && verify; i++) {
+        int error = abs(heights[i] - ((int)(full[i] * 10) + 10));
+        worst = std::max(worst, error);
+        if (error > max_height_error) {
+            error_columns++;
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    height_samples += samples;
+    worst_height_error = std::max(worst_height_error, worst);
+    height_error_columns += error_columns;
+}
+
+void WorldGenerator::get_solid_blocks(glm::vec2 chunk_pos, const std::array<int, 256>& heights, std::array<bool, 16 * DENSITY_DEPTH * 16>& solid)
+{
+    const int cells_xz = 16 / DENSITY_STEP + 1;
+    const int cells_y = (DENSITY_DEPTH - 1) / DENSITY_STEP + 2;
+    std::array<float, cells_xz * cells_y * cells_xz> density;
+    std::array<float, cells_xz * cells_y * cells_xz> caves;
+
+    for (int x = 0; x < cells_xz; x++) {
+        for (int y = 0; y < cells_y; y++) {
+            for (int z = 0; z < cells_xz; z++) {
+                float wx = (float)(x * DENSITY_STEP + chunk_pos.x * 16);
+                float wy = (float)(y * DENSITY_STEP);
+                float wz = (float)(z * DENSITY_STEP + chunk_pos.y * 16);
+                density[(x * cells_y + y) * cells_xz + z] = density_noise.GetNoise(wx, wy, wz);
+                caves[(x * cells_y + y) * cells_xz + z] = cave_noise.GetNoise(wx, wy, wz);
+            }
+        }
+    }
+
+    auto trilinear = [&](const std::array<float, cells_xz * cells_y * cells_xz>& lattice, int cx, int cy, int cz, float fx, float fy, float fz) {
+        auto at = [&](int x, int y, int z) { return lattice[((cx + x) * cells_y + cy + y) * cells_xz + cz + z]; };
+        float x00 = glm::mix(at(0, 0, 0), at(1, 0, 0), fx);
+        float x10 = glm::mix(at(0, 1, 0), at(1, 1, 0), fx);
+        float x01 = glm::mix(at(0, 0, 1), at(1, 0, 1), fx);
+        float x11 = glm::mix(at(0, 1, 1), at(1, 1, 1), fx);
+        return glm::mix(glm::mix(x00, x10, fy), glm::mix(x01, x11, fy), fz);
+    };
+
+    for (int x = 0; x < 16; x++) {
+        for (int y = 0; y < DENSITY_DEPTH; y++) {
+            for (int z = 0; z < 16; z++) {
+                int cx = x / DENSITY_STEP, cy = y / DENSITY_STEP, cz = z / DENSITY_STEP;
+                float fx = (float)(x % DENSITY_STEP) / DENSITY_STEP;
+                float fy = (float)(y % DENSITY_STEP) / DENSITY_STEP;
+                float fz = (float)(z % DENSITY_STEP) / DENSITY_STEP;
+
+                int depth = y - heights[x * 16 + z];
+                bool is_solid = depth / density_squash + trilinear(density, cx, cy, cz, fx, fy, fz) > 0;
+                if (is_solid && depth >= cave_min_depth) {
+                    is_solid = std::abs(trilinear(caves, cx, cy, cz, fx, fy, fz)) >= cave_threshold;
+                }
+                solid[(x * DENSITY_DEPTH + y) * 16 + z] = is_solid;
+            }
+        }
+    }
+}
+
+void WorldGenerator::record_generation_time(TerrainMode mode, float ms)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    generated_chunks[mode]++;
+    generation_ms[mode] += (ms - generation_ms[mode]) / generated_chunks[mode];
+}
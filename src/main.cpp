@@ -1,11 +1,30 @@
 #include <iostream>
+#include <random>
+#include <cstdlib>
+#include <cstdint>
+#include <cerrno>
+#include <cctype>
 
 #include "VkEngine.hpp"
 #include "Bassicraft.hpp"
 
 int main(int argc, char* argv[]) {
+    uint32_t seed = std::random_device{}();
+    if (argc > 1) {
+        // strtoul takes a sign and wraps negative numbers around
+        char* end = nullptr;
+        errno = 0;
+        unsigned long value = strtoul(argv[1], &end, 10);
+        if (!isdigit((unsigned char)argv[1][0]) || *end != '\0' || errno == ERANGE || value > UINT32_MAX) {
+            std::cerr << "Usage: " << argv[0] << " [seed]" << std::endl;
+            return 84;
+        }
+        seed = (uint32_t)value;
+    }
+    std::cout << "World seed: " << seed << std::endl;
+
     try {
-        Bassicraft game;
+        Bassicraft game(seed);
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
         return 84;
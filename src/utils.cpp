@@ -1,6 +1,7 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <random>
 
 #include <vulkan/vulkan.h>
 
@@ -43,8 +44,9 @@ int regular_modulo(int a, int b)
     return (a % b + b) % b;
 }
 
+// Not for world generation, which uses ChunkRandom to stay reproducible
 float rand_float(float smallNumber, float bigNumber)
 {
-    float diff = bigNumber - smallNumber;
-    return (((float) rand() / RAND_MAX) * diff) + smallNumber;
+    thread_local std::minstd_rand engine(std::random_device{}());
+    return std::uniform_real_distribution<float>(smallNumber, bigNumber)(engine);
 }